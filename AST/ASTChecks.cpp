@@ -0,0 +1,217 @@
+#include "ASTNode.h"
+#include "ASTVisitor.h"
+#include "Bytecode.h"
+#include "Parser.h"
+#include "VirtualMachine.h"
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace AST;
+
+// Differential checks of the VirtualMachine against the tree Interpreter,
+// which remains the reference semantics for the rule language, and
+// regression checks for the StreamingJSONParser. These are built twice, once
+// with the computed goto dispatch and once with the switch fallback, and exit
+// with a nonzero status on any failure.
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& description) {
+    if (!condition) {
+        std::cerr << "FAILED: " << description << "\n";
+        ++failures;
+    }
+}
+
+class RecordingCommunication : public Communication {
+    public:
+        virtual void sendGlobalMessage(std::string_view message) override {
+            sent.emplace_back(message);
+        }
+        std::vector<std::string> sent;
+};
+
+// Runs the tree through both the Interpreter and the VirtualMachine and
+// checks that they sent the same messages in the same order.
+std::vector<std::string> runBoth(const AST::AST& tree, const std::string& description) {
+    RecordingCommunication interpreted;
+    Interpreter interpreter{Environment{nullptr}, interpreted};
+    tree.accept(interpreter);
+
+    RecordingCommunication executed;
+    VirtualMachine machine{Environment{nullptr}, executed};
+    auto program = Compiler{}.compile(tree);
+    machine.run(program);
+    // Programs are reusable, so a second run must repeat the first.
+    machine.run(program);
+
+    auto twice = interpreted.sent;
+    twice.insert(twice.end(), interpreted.sent.begin(), interpreted.sent.end());
+    check(twice == executed.sent, description + ": interpreter and VM differ");
+    return interpreted.sent;
+}
+
+AST::AST buildTree(const std::vector<std::string>& messages) {
+    auto arena = std::make_unique<Arena>();
+    auto* root = arena->create<Rules>(*arena);
+    for (auto& message : messages) {
+        auto* format = arena->create<FormatNode>(*arena, arena->copyString(message));
+        root->appendRule(arena->create<GlobalMessage>(*arena, format));
+    }
+    return AST::AST{std::move(arena), root};
+}
+
+void checkBuiltTrees() {
+    RecordingCommunication nothing;
+    VirtualMachine{Environment{nullptr}, nothing}.run(Program{});
+    check(nothing.sent.empty(), "a default constructed program does nothing");
+
+    check(runBoth(buildTree({}), "empty rules").empty(), "empty rules send nothing");
+
+    auto sent = runBoth(buildTree({"Round 1", "", "Round 1", "Choose your weapon!"}),
+                        "repeated constants");
+    check(sent == std::vector<std::string>{"Round 1", "", "Round 1", "Choose your weapon!"},
+          "messages are sent in rule order");
+
+    std::vector<std::string> many;
+    for (int i = 0; i < 10000; ++i) {
+        many.push_back("Message " + std::to_string(i % 97));
+    }
+    check(runBoth(buildTree(many), "large tree") == many, "large tree sends every message");
+
+    // Nested rule lists flatten into one instruction stream.
+    auto arena = std::make_unique<Arena>();
+    auto* outer = arena->create<Rules>(*arena);
+    auto* inner = arena->create<Rules>(*arena);
+    auto message = [&] (std::string_view text) {
+        return arena->create<GlobalMessage>(*arena, arena->create<FormatNode>(*arena, text));
+    };
+    outer->appendRule(message("first"));
+    inner->appendRule(message("second"));
+    inner->appendRule(message("third"));
+    outer->appendRule(inner);
+    outer->appendRule(message("fourth"));
+    AST::AST nested{std::move(arena), outer};
+    check(runBoth(nested, "nested rules")
+            == std::vector<std::string>{"first", "second", "third", "fourth"},
+          "nested rules run depth first");
+}
+
+AST::AST parse(std::string source) {
+    auto buffer = std::make_shared<const std::string>(std::move(source));
+    return ASTParser{std::make_unique<StreamingJSONParser>(std::move(buffer))}.parse();
+}
+
+void checkParsed(const std::string& source, const std::vector<std::string>& expected,
+                 const std::string& description) {
+    try {
+        // The AST must keep the source alive on its own.
+        auto tree = parse(source);
+        check(runBoth(tree, description) == expected, description + ": unexpected messages");
+    } catch (const std::exception& e) {
+        check(false, description + ": threw " + e.what());
+    }
+}
+
+void checkRejected(const std::string& source, const std::string& description) {
+    try {
+        parse(source);
+        check(false, description + ": was accepted");
+    } catch (const ParseError&) {
+    }
+}
+
+void checkParser() {
+    checkParsed(R"({"rules": []})", {}, "empty rules");
+    checkParsed(R"({"rules": [{"rule": "global-message", "value": "plain"}]})",
+                {"plain"}, "single rule");
+    checkParsed(R"({"rules": [{"value": "late kind", "rule": "global-message"}]})",
+                {"late kind"}, "keys in any order");
+    checkParsed(" \n\t{\"rules\"\r\n:\t[ ]\n} ", {}, "whitespace everywhere");
+
+    // Unused sections are skipped, including every kind of scalar and
+    // strings that look like structure.
+    checkParsed(R"({"configuration": {"name": "Rock", "player count": {"min": 2, "max": 4},)"
+                R"( "audience": false, "setup": {"rounds": [1, -2.5e3, 0.25, 1E+2, true, null]}},)"
+                R"( "constants": {"tricky": "\"}]\\", "empty": {}, "none": []},)"
+                R"( "rules": [{"rule": "global-message", "extra": [[{}]], "value": "after"}]})",
+                {"after"}, "skipped sections");
+
+    // Escapes are decoded into UTF-8, including surrogate pairs.
+    checkParsed(R"({"rules": [{"rule": "global-message",)"
+                R"( "value": "q\"b\\s\/n\nt\tu\u00e9\u20AC\ud83d\ude00"}]})",
+                {"q\"b\\s/n\nt\tu\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"}, "escapes");
+    checkParsed(R"({"r\u0075les": [{"rule": "global-message", "value": "escaped key"}]})",
+                {"escaped key"}, "escaped key");
+
+    // Nesting deeper than any call stack is skipped iteratively.
+    std::string deep(200000, '[');
+    deep += std::string(200000, ']');
+    checkParsed(R"({"variables": )" + deep + R"(, "rules": []})", {}, "deep nesting");
+
+    std::istringstream stream{R"({"rules": [{"rule": "global-message", "value": "streamed"}]})"};
+    auto tree = ASTParser{std::make_unique<StreamingJSONParser>(
+        StreamingJSONParser::readSource(stream))}.parse();
+    check(runBoth(tree, "read from stream") == std::vector<std::string>{"streamed"},
+          "read from stream");
+
+    const char* malformed[] = {
+        "",
+        "{",
+        "[]",
+        R"({"rules": []} x)",
+        R"({"rules": [],})",
+        R"({"rules": [] "x": 1})",
+        R"({"x": [1 2], "rules": []})",
+        R"({"x": [1,], "rules": []})",
+        R"({"x": {"a" 1}, "rules": []})",
+        R"({"x": {"a": 1,}, "rules": []})",
+        R"({"x": [}], "rules": []})",
+        R"({"x": tru, "rules": []})",
+        R"({"x": nul, "rules": []})",
+        R"({"x": -, "rules": []})",
+        R"({"x": 1., "rules": []})",
+        R"({"x": 1e, "rules": []})",
+        R"({"x": "\q", "rules": []})",
+        R"({"x": "unterminated, "rules": []})",
+        "{\"x\": \"line\nbreak\", \"rules\": []}",
+        R"({"rules": [{"rule": "global-message", "value": "\ud800"}]})",
+        R"({"rules": [{"rule": "global-message", "value": "\ude00"}]})",
+        R"({"rules": [{"rule": "global-message", "value": "\u12"}]})",
+        R"({"rules": [{"rule": "global-message", "value": "\uzzzz"}]})",
+        R"({"configuration": {}})",
+        R"({"rules": {}})",
+        R"({"rules": [{"rule": "add", "value": 1}]})",
+        R"({"rules": [{"rule": "global-message"}]})",
+        R"({"rules": [{"rule": "global-message", "value": 5}]})",
+    };
+    for (auto* source : malformed) {
+        checkRejected(source, std::string{"malformed input "} + source);
+    }
+
+    try {
+        parse(R"({"rules": [{"rule": "add"}]})");
+        check(false, "unsupported rules are rejected");
+    } catch (const ParseError& e) {
+        check(e.getOffset() == 11, "errors report the offset of the rule");
+    }
+}
+
+}
+
+int main() {
+    checkBuiltTrees();
+    checkParser();
+    if (failures != 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "All AST checks passed\n";
+    return 0;
+}
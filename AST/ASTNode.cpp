@@ -2,11 +2,19 @@
 #include "ASTVisitor.h"
 
 namespace AST {
-    void GlobalMessage::acceptHelper(ASTVisitor& visitor) {
+    void Rules::acceptHelper(ASTVisitor& visitor) const {
         visitor.visit(*this);
     }
-    void GlobalMessage::acceptForChildrenHelper(ASTVisitor& visitor) {
-        for (auto& child : children) {
+    void Rules::acceptForChildrenHelper(ASTVisitor& visitor) const {
+        for (auto* child : getChildren()) {
+            child->accept(visitor);
+        }
+    }
+    void GlobalMessage::acceptHelper(ASTVisitor& visitor) const {
+        visitor.visit(*this);
+    }
+    void GlobalMessage::acceptForChildrenHelper(ASTVisitor& visitor) const {
+        for (auto* child : getChildren()) {
             child->accept(visitor);
         }
     }
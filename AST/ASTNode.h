@@ -3,91 +3,124 @@
 
 #include <vector>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <algorithm>
 #include <string>
+#include <string_view>
+#include "Arena.h"
 
 namespace AST {
 
 class ASTVisitor;
 
+// Nodes are created in the Arena of the AST that they belong to, and their
+// children are arena pointers, so a node must never outlive its Arena.
 class ASTNode {
     public:
+        explicit ASTNode(Arena& arena) : children{arena.getResource()} {}
         int getChildrenCount() const {
             return this->numChildren;
         }
-        const std::vector<ASTNode const*> getChildren() const {
-            std::vector<ASTNode const*> returnValue;
-            for (auto& x : children) {
-                returnValue.push_back(x.get());
-            }
-            return returnValue;
+        // Views over the children in place; walking a tree never allocates.
+        std::span<ASTNode const* const> getChildren() const {
+            return {children.data(), children.size()};
+        }
+        std::span<ASTNode* const> getChildren() {
+            return {children.data(), children.size()};
         }
         const ASTNode& getParent() const {
             return *parent;
         }
         void setParent(ASTNode* parent) {
-            parent = parent;
+            this->parent = parent;
         }
-        void accept(ASTVisitor& visitor) {
+        // Visiting never modifies a tree, so a parsed tree can be shared
+        // read only between games.
+        void accept(ASTVisitor& visitor) const {
             acceptHelper(visitor);
         }
-        void acceptForChildren(ASTVisitor& visitor) {
+        void acceptForChildren(ASTVisitor& visitor) const {
             acceptForChildrenHelper(visitor);
         }
         virtual ~ASTNode() {};
     protected:
-        std::vector<std::unique_ptr<ASTNode>> children;
-        ASTNode* parent;
-        int numChildren;
-        void appendChild(std::unique_ptr<ASTNode> &&child) {
-            children.push_back(std::move(child));
+        std::pmr::vector<ASTNode*> children;
+        ASTNode* parent = nullptr;
+        int numChildren = 0;
+        void appendChild(ASTNode* child) {
+            child->setParent(this);
+            children.push_back(child);
+            ++numChildren;
         }
     private:
-        virtual void acceptHelper(ASTVisitor& visitor) = 0;
-        virtual void acceptForChildrenHelper(ASTVisitor& visitor) = 0;
+        virtual void acceptHelper(ASTVisitor& visitor) const = 0;
+        virtual void acceptForChildrenHelper(ASTVisitor& visitor) const = 0;
 
 };
 
+class Rules : public ASTNode {
+    public:
+        explicit Rules(Arena& arena) : ASTNode{arena} {}
+        void appendRule(ASTNode* rule) {
+            appendChild(rule);
+        }
+    private:
+        virtual void acceptHelper(ASTVisitor& visitor) const override;
+        virtual void acceptForChildrenHelper(ASTVisitor& visitor) const override;
+};
+
 class FormatNode : public ASTNode {
     public:
-        FormatNode(std::string format): format{std::move(format)} {}
-        const std::string& getFormat() {
+        // The text is not copied. It must live as long as the Arena, either
+        // copied with Arena::copyString() or in a buffer that it retains.
+        FormatNode(Arena& arena, std::string_view format)
+            : ASTNode{arena}, format{format} {}
+        std::string_view getFormat() const {
             return format;
         }
     private:
-        virtual void acceptHelper(ASTVisitor& visitor) override {}
-        virtual void acceptForChildrenHelper(ASTVisitor& visitor) override {}
-        std::string format;
+        virtual void acceptHelper(ASTVisitor& visitor) const override {}
+        virtual void acceptForChildrenHelper(ASTVisitor& visitor) const override {}
+        std::string_view format;
 };
 
 
 class GlobalMessage : public ASTNode {
     public:
-        GlobalMessage(std::unique_ptr<FormatNode> &&formatNode) {
-            appendChild(std::move(formatNode));
+        GlobalMessage(Arena& arena, FormatNode* formatNode) : ASTNode{arena} {
+            appendChild(formatNode);
         }
         const FormatNode& getFormateNode() const {
-            return *static_cast<FormatNode*>(children[0].get());
+            return *static_cast<FormatNode*>(children[0]);
         }
     private:
-        virtual void acceptHelper(ASTVisitor& visitor) override;
-        virtual void acceptForChildrenHelper(ASTVisitor& visitor) override;
+        virtual void acceptHelper(ASTVisitor& visitor) const override;
+        virtual void acceptForChildrenHelper(ASTVisitor& visitor) const override;
 };
 
+// An AST owns the Arena that all of its nodes were created in, so a whole
+// rule tree is released at once when the AST is destroyed.
 class AST {
     public:
-        AST(std::unique_ptr<ASTNode> &&root) : root{std::move(root)} {}
+        AST(std::unique_ptr<Arena> &&arena, ASTNode* root)
+            : arena{std::move(arena)}, root{root} {}
         const ASTNode& getParent() const {
             return *root;
         }
-        void setRoot(std::unique_ptr<ASTNode>&& root) {
-            root.swap(this->root);
+        // The new root must have been created in this AST's Arena.
+        void setRoot(ASTNode* root) {
+            this->root = root;
+        }
+        Arena& getArena() {
+            return *arena;
         }
-        void accept(ASTVisitor& visitor) {
+        void accept(ASTVisitor& visitor) const {
             root->accept(visitor);
         }
     private:
-        std::unique_ptr<ASTNode> root;
+        std::unique_ptr<Arena> arena;
+        ASTNode* root;
 };
 
 
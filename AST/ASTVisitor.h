@@ -2,6 +2,7 @@
 #define AST_VISITOR_H
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <iostream>
 #include <variant>
@@ -11,9 +12,10 @@ namespace AST {
 
 class Communication {
     public:
-        void sendGlobalMessage(std::string &message) {
+        virtual void sendGlobalMessage(std::string_view message) {
             std::cout << message << std::endl;
         }
+        virtual ~Communication() = default;
 };
 
 class DSLValue;
@@ -112,10 +114,12 @@ class Environment {
 
 class ASTVisitor {
     public:
-        void visit(GlobalMessage& node) { visitHelper(node); }
+        void visit(const Rules& node) { visitHelper(node); }
+        void visit(const GlobalMessage& node) { visitHelper(node); }
         virtual ~ASTVisitor() = default;
     private:
-        virtual void visitHelper(GlobalMessage&) = 0;
+        virtual void visitHelper(const Rules&) = 0;
+        virtual void visitHelper(const GlobalMessage&) = 0;
 };
 
 
@@ -124,13 +128,18 @@ class Interpreter : public ASTVisitor {
         Interpreter(Environment&& env, Communication &communication) : 
             environment{std::move(env)}, communication{communication} {}
     private:
-        virtual void visitHelper(GlobalMessage& node) { 
+        virtual void visitHelper(const Rules& node) {
+            node.acceptForChildren(*this);
+        }
+        virtual void visitHelper(const GlobalMessage& node) { 
             visitEnter(node);
             node.acceptForChildren(*this); 
             visitLeave(node);
         }
-        void visitEnter(GlobalMessage& node) {};
-        void visitLeave(GlobalMessage& node) {};
+        void visitEnter(const GlobalMessage& node) {
+            communication.sendGlobalMessage(node.getFormateNode().getFormat());
+        };
+        void visitLeave(const GlobalMessage& node) {};
     private:
         Environment environment;
         Communication &communication;
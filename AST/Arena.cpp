@@ -0,0 +1,20 @@
+#include "Arena.h"
+
+#include <cstring>
+
+namespace AST {
+    Arena::~Arena() {
+        for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+            it->destroy(it->object);
+        }
+    }
+
+    std::string_view Arena::copyString(std::string_view text) {
+        if (text.empty()) {
+            return {};
+        }
+        auto* memory = static_cast<char*>(resource.allocate(text.size(), alignof(char)));
+        std::memcpy(memory, text.data(), text.size());
+        return {memory, text.size()};
+    }
+}
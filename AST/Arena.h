@@ -0,0 +1,71 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace AST {
+
+// Bump allocates every node of a rule tree from a few large blocks, so that
+// a tree is laid out contiguously in creation order and is freed in one shot
+// when its Arena is destroyed. Objects are never freed individually, but
+// their destructors still run, in reverse order of creation.
+class Arena {
+    public:
+        explicit Arena(std::size_t initialSize = 4096)
+            : resource{initialSize} {}
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        ~Arena();
+
+        template <typename T, typename... Args>
+        T* create(Args&&... args) {
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                // Make room first so that registering cannot throw after
+                // the object has been constructed.
+                if (destructors.size() == destructors.capacity()) {
+                    destructors.reserve(std::max<std::size_t>(16, destructors.size() * 2));
+                }
+            }
+            void* memory = resource.allocate(sizeof(T), alignof(T));
+            T* object = ::new (memory) T(std::forward<Args>(args)...);
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                destructors.push_back({object, [] (void* o) { static_cast<T*>(o)->~T(); }});
+            }
+            return object;
+        }
+
+        // Copies the characters into the arena so that the view lives as
+        // long as the tree does.
+        std::string_view copyString(std::string_view text);
+
+        // Keeps a buffer alive for as long as the arena, so that nodes may
+        // hold views into it instead of copies.
+        void retain(std::shared_ptr<const void> buffer) {
+            retained.push_back(std::move(buffer));
+        }
+
+        std::pmr::memory_resource* getResource() noexcept {
+            return &resource;
+        }
+    private:
+        struct Destructor {
+            void* object;
+            void (*destroy)(void*);
+        };
+
+        std::pmr::monotonic_buffer_resource resource;
+        std::vector<Destructor> destructors;
+        std::vector<std::shared_ptr<const void>> retained;
+};
+
+}
+
+#endif
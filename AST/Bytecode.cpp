@@ -0,0 +1,32 @@
+#include "Bytecode.h"
+
+namespace AST {
+    Program Compiler::compile(const AST& ast) {
+        program = Program{};
+        constantIndices.clear();
+        ast.accept(*this);
+        emit(OpCode::HALT);
+        return std::move(program);
+    }
+
+    void Compiler::visitHelper(const Rules& node) {
+        node.acceptForChildren(*this);
+    }
+
+    void Compiler::visitHelper(const GlobalMessage& node) {
+        emit(OpCode::GLOBAL_MESSAGE, addConstant(node.getFormateNode().getFormat()));
+    }
+
+    void Compiler::emit(OpCode opCode, uint32_t operand) {
+        program.code.push_back(Instruction{opCode, operand});
+    }
+
+    uint32_t Compiler::addConstant(std::string_view constant) {
+        auto [found, inserted] =
+            constantIndices.try_emplace(constant, program.constants.size());
+        if (inserted) {
+            program.constants.push_back(constant);
+        }
+        return found->second;
+    }
+}
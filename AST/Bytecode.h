@@ -0,0 +1,58 @@
+#ifndef AST_BYTECODE_H
+#define AST_BYTECODE_H
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ASTNode.h"
+#include "ASTVisitor.h"
+
+namespace AST {
+
+enum class OpCode : uint8_t {
+    GLOBAL_MESSAGE,
+    HALT
+};
+
+// Operands index into the constant pool of the Program being executed.
+struct Instruction {
+    OpCode opCode;
+    uint32_t operand;
+};
+
+// A rule tree flattened into a compact instruction stream. The constants are
+// views into the Arena of the AST that the Program was compiled from, so a
+// Program must not outlive that AST.
+class Program {
+    public:
+        const std::vector<Instruction>& getCode() const {
+            return code;
+        }
+        const std::vector<std::string_view>& getConstants() const {
+            return constants;
+        }
+    private:
+        friend class Compiler;
+        std::vector<Instruction> code;
+        std::vector<std::string_view> constants;
+};
+
+// Compiles a tree into a Program for the VirtualMachine. The tree Interpreter
+// remains the reference semantics, so both must produce the same effects.
+class Compiler : public ASTVisitor {
+    public:
+        Program compile(const AST& ast);
+    private:
+        virtual void visitHelper(const Rules& node) override;
+        virtual void visitHelper(const GlobalMessage& node) override;
+        void emit(OpCode opCode, uint32_t operand = 0);
+        uint32_t addConstant(std::string_view constant);
+
+        Program program;
+        std::unordered_map<std::string_view, uint32_t> constantIndices;
+};
+
+}
+
+#endif
@@ -0,0 +1,371 @@
+#include "Parser.h"
+
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+namespace AST {
+
+namespace {
+
+// Pulls JSON tokens out of a buffer one at a time, so that nothing beyond
+// the current token is ever materialized. Strings are returned as views into
+// the buffer unless they contain escapes, in which case they are decoded
+// into the Arena.
+class JSONReader {
+    public:
+        JSONReader(std::string_view text, Arena& arena) : text{text}, arena{arena} {}
+
+        std::size_t getOffset() const {
+            return position;
+        }
+
+        char peek() {
+            skipWhitespace();
+            if (position == text.size()) {
+                fail("unexpected end of input");
+            }
+            return text[position];
+        }
+
+        void beginObject() {
+            expect('{');
+            atStart = true;
+        }
+
+        // Reads the next key of the current object, or returns false after
+        // consuming the closing brace.
+        bool nextKey(std::string_view& key) {
+            if (!nextMember('}')) {
+                return false;
+            }
+            key = readString();
+            expect(':');
+            return true;
+        }
+
+        void beginArray() {
+            expect('[');
+            atStart = true;
+        }
+
+        // Returns false after consuming the closing bracket.
+        bool nextElement() {
+            return nextMember(']');
+        }
+
+        std::string_view readString() {
+            expect('"');
+            auto start = position;
+            while (position < text.size()) {
+                char c = text[position];
+                if (c == '"') {
+                    ++position;
+                    return text.substr(start, position - start - 1);
+                } else if (c == '\\') {
+                    return readEscapedString(start);
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    fail("control character in string");
+                }
+                ++position;
+            }
+            fail("unterminated string");
+        }
+
+        // Skips a whole value of any type. Containers are walked with an
+        // explicit stack so that deeply nested input cannot overflow ours.
+        void skipValue() {
+            closers.clear();
+            do {
+                if (!closers.empty()) {
+                    char close = closers.back();
+                    if (!nextMember(close)) {
+                        closers.pop_back();
+                        continue;
+                    }
+                    if (close == '}') {
+                        skipString();
+                        expect(':');
+                    }
+                }
+                switch (peek()) {
+                    case '{': ++position; atStart = true; closers.push_back('}'); break;
+                    case '[': ++position; atStart = true; closers.push_back(']'); break;
+                    case '"': skipString(); break;
+                    case 't': expectLiteral("true"); break;
+                    case 'f': expectLiteral("false"); break;
+                    case 'n': expectLiteral("null"); break;
+                    default: skipNumber(); break;
+                }
+            } while (!closers.empty());
+        }
+
+        void expectEnd() {
+            skipWhitespace();
+            if (position != text.size()) {
+                fail("unexpected data after the document");
+            }
+        }
+
+        [[noreturn]] void fail(const std::string& message) const {
+            throw ParseError{message, position};
+        }
+
+    private:
+        void skipWhitespace() {
+            while (position < text.size()) {
+                char c = text[position];
+                if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+                    return;
+                }
+                ++position;
+            }
+        }
+
+        void expect(char c) {
+            if (peek() != c) {
+                fail(std::string{"expected '"} + c + "'");
+            }
+            ++position;
+        }
+
+        void expectLiteral(std::string_view literal) {
+            if (text.substr(position, literal.size()) != literal) {
+                fail("invalid literal");
+            }
+            position += literal.size();
+        }
+
+        // A separating comma is required between members, but not before
+        // the first one. atStart is only still set when nothing has been
+        // read since the container was opened.
+        bool nextMember(char close) {
+            char c = peek();
+            if (c == close) {
+                ++position;
+                atStart = false;
+                return false;
+            } else if (c == ',' && !atStart) {
+                ++position;
+                if (peek() == close) {
+                    fail("trailing comma");
+                }
+            } else if (!atStart) {
+                fail(std::string{"expected ',' or '"} + close + "'");
+            }
+            atStart = false;
+            return true;
+        }
+
+        void skipString() {
+            expect('"');
+            while (position < text.size()) {
+                char c = text[position++];
+                if (c == '"') {
+                    return;
+                } else if (c == '\\') {
+                    // Skipped strings are never decoded, so only the escape
+                    // character itself is checked.
+                    if (position == text.size()
+                            || std::string_view{"\"\\/bfnrtu"}.find(text[position]) == std::string_view::npos) {
+                        fail("invalid escape");
+                    }
+                    ++position;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    --position;
+                    fail("control character in string");
+                }
+            }
+            fail("unterminated string");
+        }
+
+        void skipNumber() {
+            auto digits = [this] {
+                auto start = position;
+                while (position < text.size() && '0' <= text[position] && text[position] <= '9') {
+                    ++position;
+                }
+                if (start == position) {
+                    fail("invalid number");
+                }
+            };
+            auto accept = [this] (std::string_view options) {
+                if (position < text.size() && options.find(text[position]) != std::string_view::npos) {
+                    ++position;
+                    return true;
+                }
+                return false;
+            };
+            accept("-");
+            digits();
+            if (accept(".")) {
+                digits();
+            }
+            if (accept("eE")) {
+                accept("+-");
+                digits();
+            }
+        }
+
+        uint32_t readHex() {
+            if (text.size() - position < 4) {
+                fail("truncated unicode escape");
+            }
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                char c = text[position++];
+                value <<= 4;
+                if ('0' <= c && c <= '9') {
+                    value |= c - '0';
+                } else if ('a' <= (c | 0x20) && (c | 0x20) <= 'f') {
+                    value |= (c | 0x20) - 'a' + 10;
+                } else {
+                    fail("invalid unicode escape");
+                }
+            }
+            return value;
+        }
+
+        void appendUTF8(uint32_t codePoint) {
+            if (codePoint < 0x80) {
+                decoded += static_cast<char>(codePoint);
+            } else if (codePoint < 0x800) {
+                decoded += static_cast<char>(0xC0 | (codePoint >> 6));
+                decoded += static_cast<char>(0x80 | (codePoint & 0x3F));
+            } else if (codePoint < 0x10000) {
+                decoded += static_cast<char>(0xE0 | (codePoint >> 12));
+                decoded += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                decoded += static_cast<char>(0x80 | (codePoint & 0x3F));
+            } else {
+                decoded += static_cast<char>(0xF0 | (codePoint >> 18));
+                decoded += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+                decoded += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                decoded += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        std::string_view readEscapedString(std::size_t start) {
+            decoded.assign(text.substr(start, position - start));
+            while (position < text.size()) {
+                char c = text[position++];
+                if (c == '"') {
+                    return arena.copyString(decoded);
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    --position;
+                    fail("control character in string");
+                } else if (c != '\\') {
+                    decoded += c;
+                    continue;
+                }
+                if (position == text.size()) {
+                    break;
+                }
+                switch (text[position++]) {
+                    case '"':  decoded += '"'; break;
+                    case '\\': decoded += '\\'; break;
+                    case '/':  decoded += '/'; break;
+                    case 'b':  decoded += '\b'; break;
+                    case 'f':  decoded += '\f'; break;
+                    case 'n':  decoded += '\n'; break;
+                    case 'r':  decoded += '\r'; break;
+                    case 't':  decoded += '\t'; break;
+                    case 'u': {
+                        auto codePoint = readHex();
+                        if (0xD800 <= codePoint && codePoint < 0xDC00) {
+                            expectLiteral("\\u");
+                            auto low = readHex();
+                            if (low < 0xDC00 || 0xE000 <= low) {
+                                fail("invalid surrogate pair");
+                            }
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        } else if (0xDC00 <= codePoint && codePoint < 0xE000) {
+                            fail("invalid surrogate pair");
+                        }
+                        appendUTF8(codePoint);
+                        break;
+                    }
+                    default:
+                        --position;
+                        fail("invalid escape");
+                }
+            }
+            fail("unterminated string");
+        }
+
+        std::string_view text;
+        Arena& arena;
+        std::size_t position = 0;
+        bool atStart = false;
+        std::string decoded;
+        std::vector<char> closers;
+};
+
+ASTNode* parseRule(JSONReader& reader, Arena& arena) {
+    auto offset = reader.getOffset();
+    std::string_view kind;
+    std::string_view value;
+    bool hasValue = false;
+
+    reader.beginObject();
+    std::string_view key;
+    while (reader.nextKey(key)) {
+        if (key == "rule") {
+            kind = reader.readString();
+        } else if (key == "value" && reader.peek() == '"') {
+            value = reader.readString();
+            hasValue = true;
+        } else {
+            reader.skipValue();
+        }
+    }
+
+    if (kind == "global-message" && hasValue) {
+        auto* format = arena.create<FormatNode>(arena, value);
+        return arena.create<GlobalMessage>(arena, format);
+    }
+    throw ParseError{"unsupported rule \"" + std::string{kind} + "\"", offset};
+}
+
+Rules* parseRules(JSONReader& reader, Arena& arena) {
+    auto* rules = arena.create<Rules>(arena);
+    reader.beginArray();
+    while (reader.nextElement()) {
+        rules->appendRule(parseRule(reader, arena));
+    }
+    return rules;
+}
+
+}
+
+std::shared_ptr<const std::string> StreamingJSONParser::readSource(std::istream& in) {
+    return std::make_shared<const std::string>(std::istreambuf_iterator<char>{in},
+                                               std::istreambuf_iterator<char>{});
+}
+
+AST StreamingJSONParser::parseHelper() {
+    auto arena = std::make_unique<Arena>();
+    arena->retain(source);
+    JSONReader reader{*source, *arena};
+
+    Rules* rules = nullptr;
+    reader.beginObject();
+    std::string_view key;
+    while (reader.nextKey(key)) {
+        if (key == "rules" && !rules) {
+            rules = parseRules(reader, *arena);
+        } else {
+            // Configuration, constants and variables are not part of the
+            // AST yet.
+            reader.skipValue();
+        }
+    }
+    reader.expectEnd();
+
+    if (!rules) {
+        reader.fail("missing \"rules\"");
+    }
+    return AST{std::move(arena), rules};
+}
+
+}
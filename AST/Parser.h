@@ -3,18 +3,34 @@
 
 #include "ASTNode.h"
 #include "ASTVisitor.h"
+#include <cstddef>
+#include <istream>
 #include <memory>
+#include <stdexcept>
+#include <string>
 
 class JSON;
 
 namespace AST {
 
+class ParseError : public std::runtime_error {
+    public:
+        ParseError(const std::string& what, std::size_t offset)
+            : std::runtime_error{what + " at offset " + std::to_string(offset)},
+              offset{offset} {}
+        std::size_t getOffset() const {
+            return offset;
+        }
+    private:
+        std::size_t offset;
+};
+
 class DomainSpecificParser {
     public:
         AST parse() {
             return parseHelper();
         }
-        virtual ~DomainSpecificParser();
+        virtual ~DomainSpecificParser() = default;
     private:
         virtual AST parseHelper() = 0;
 };
@@ -41,8 +57,24 @@ class JSONToASTParser : public DomainSpecificParser {
         const JSON &json;
         // Implement these in a Top Down fashion
         virtual AST parseHelper() override;
-        FormatNode parseFormatNode();
-        GlobalMessage parseGlobalMessage();
+        // Nodes are created in the Arena of the AST being parsed.
+        FormatNode* parseFormatNode(Arena& arena);
+        GlobalMessage* parseGlobalMessage(Arena& arena);
+};
+
+// Builds an AST directly from the text of a JSON game specification without
+// first parsing it into a DOM. Strings become views into the source, which
+// the AST's Arena retains; only strings with escapes are decoded into the
+// Arena. Throws ParseError on malformed input or unsupported rules.
+class StreamingJSONParser : public DomainSpecificParser {
+    public:
+        explicit StreamingJSONParser(std::shared_ptr<const std::string> source)
+            : source{std::move(source)} {}
+        // Reads a whole stream, e.g. a file, into a buffer for parsing.
+        static std::shared_ptr<const std::string> readSource(std::istream& in);
+    private:
+        std::shared_ptr<const std::string> source;
+        virtual AST parseHelper() override;
 };
 
 }
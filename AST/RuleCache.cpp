@@ -0,0 +1,43 @@
+#include "RuleCache.h"
+
+#include <functional>
+
+namespace AST {
+    uint64_t RuleCache::hash(std::string_view source) noexcept {
+        return std::hash<std::string_view>{}(source);
+    }
+
+    RuleCache::Rules RuleCache::find(uint64_t digest, std::string_view source) const {
+        std::lock_guard guard{lock};
+        auto found = entries.find(digest);
+        if (found == entries.end() || found->second.source != source) {
+            return nullptr;
+        }
+        return found->second.rules;
+    }
+
+    RuleCache::Rules RuleCache::insert(uint64_t digest, std::string_view source, Rules rules) {
+        std::lock_guard guard{lock};
+        auto [found, inserted] =
+            entries.try_emplace(digest, Entry{std::string{source}, rules});
+        if (inserted || found->second.source != source) {
+            // Sources that collide with a different cached source are
+            // still correct, just not shared.
+            return rules;
+        }
+        // Another thread parsed the same source first, so share its copy.
+        return found->second.rules;
+    }
+
+    void RuleCache::prune() {
+        std::lock_guard guard{lock};
+        std::erase_if(entries, [] (const auto& entry) {
+            return entry.second.rules.use_count() == 1;
+        });
+    }
+
+    size_t RuleCache::size() const {
+        std::lock_guard guard{lock};
+        return entries.size();
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef AST_RULE_CACHE_H
+#define AST_RULE_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "ASTNode.h"
+#include "ASTVisitor.h"
+#include "Bytecode.h"
+#include "VirtualMachine.h"
+
+namespace AST {
+
+// A parsed rule tree together with its compiled Program. Neither changes
+// after construction, so any number of games may share one CompiledRules.
+class CompiledRules {
+    public:
+        explicit CompiledRules(AST &&ast)
+            : ast{std::move(ast)}, program{Compiler{}.compile(this->ast)} {}
+        const AST& getAST() const {
+            return ast;
+        }
+        const Program& getProgram() const {
+            return program;
+        }
+    private:
+        // The Program views strings in the AST's Arena, so the AST must be
+        // declared first.
+        AST ast;
+        Program program;
+};
+
+// Shares CompiledRules between all games created from the same rules
+// source. Entries are keyed by a hash of the source text, and a new game of
+// a known type skips parsing and compiling entirely. Safe to use from
+// multiple threads.
+class RuleCache {
+    public:
+        using Rules = std::shared_ptr<const CompiledRules>;
+
+        // Returns the cached rules for the source, or calls parse() to build
+        // an AST from it on a miss. parse() runs without holding the lock.
+        template <typename Parse>
+        Rules getOrParse(std::string_view source, Parse&& parse) {
+            auto digest = hash(source);
+            if (auto rules = find(digest, source)) {
+                return rules;
+            }
+            auto rules = std::make_shared<const CompiledRules>(parse());
+            return insert(digest, source, std::move(rules));
+        }
+
+        // Drops every entry that no game is using anymore.
+        void prune();
+        size_t size() const;
+
+        static uint64_t hash(std::string_view source) noexcept;
+    private:
+        struct Entry {
+            std::string source;
+            Rules rules;
+        };
+
+        Rules find(uint64_t digest, std::string_view source) const;
+        Rules insert(uint64_t digest, std::string_view source, Rules rules);
+
+        mutable std::mutex lock;
+        std::unordered_map<uint64_t, Entry> entries;
+};
+
+// One running game. The rules are shared read only with every other game of
+// the same type, while the Environment belongs to this game alone.
+class GameRules {
+    public:
+        GameRules(RuleCache::Rules rules, Communication &communication)
+            : rules{std::move(rules)},
+              machine{Environment{nullptr}, communication} {}
+        const CompiledRules& getRules() const {
+            return *rules;
+        }
+        void run() {
+            machine.run(rules->getProgram());
+        }
+    private:
+        RuleCache::Rules rules;
+        VirtualMachine machine;
+};
+
+}
+
+#endif
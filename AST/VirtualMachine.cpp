@@ -0,0 +1,56 @@
+#include "VirtualMachine.h"
+
+// GCC and Clang support jumping through a table of label addresses, which
+// lets every handler dispatch the next instruction with its own indirect
+// branch. Other compilers fall back to a switch in a loop, which can also be
+// forced with AST_NO_COMPUTED_GOTO to check both against each other.
+#if defined(__GNUC__) && !defined(AST_NO_COMPUTED_GOTO)
+#define AST_COMPUTED_GOTO 1
+#endif
+
+namespace AST {
+    void VirtualMachine::run(const Program& program) {
+        // Compiled Programs always end in HALT, but a default constructed
+        // one has no code at all and dispatching would read past it.
+        if (program.getCode().empty()) {
+            return;
+        }
+        const Instruction* ip = program.getCode().data();
+        const auto& constants = program.getConstants();
+
+#if defined(AST_COMPUTED_GOTO)
+        // Ordered to match OpCode.
+        static void* const handlers[] = {
+            &&GLOBAL_MESSAGE,
+            &&HALT
+        };
+        #define DISPATCH() goto *handlers[static_cast<uint8_t>(ip->opCode)]
+        #define CASE(opCode) opCode
+        #define NEXT() ++ip; DISPATCH()
+
+        DISPATCH();
+#else
+        #define CASE(opCode) case OpCode::opCode
+        #define NEXT() ++ip; continue
+
+        while (true) {
+        switch (ip->opCode) {
+#endif
+
+        CASE(GLOBAL_MESSAGE):
+            communication.sendGlobalMessage(constants[ip->operand]);
+            NEXT();
+
+        CASE(HALT):
+            return;
+
+#if !defined(AST_COMPUTED_GOTO)
+        }
+        }
+#endif
+
+        #undef DISPATCH
+        #undef CASE
+        #undef NEXT
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef AST_VIRTUAL_MACHINE_H
+#define AST_VIRTUAL_MACHINE_H
+
+#include "ASTVisitor.h"
+#include "Bytecode.h"
+
+namespace AST {
+
+// Executes compiled Programs with a single dispatch loop instead of a
+// virtual call per node. The Environment persists across runs, so one
+// VirtualMachine serves a game for its whole lifetime.
+class VirtualMachine {
+    public:
+        VirtualMachine(Environment&& env, Communication &communication) :
+            environment{std::move(env)}, communication{communication} {}
+        void run(const Program& program);
+    private:
+        Environment environment;
+        Communication &communication;
+};
+
+}
+
+#endif
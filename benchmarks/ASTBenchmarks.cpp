@@ -0,0 +1,184 @@
+#include "ASTNode.h"
+#include "ASTVisitor.h"
+#include "Bytecode.h"
+#include "Parser.h"
+#include "RuleCache.h"
+#include "VirtualMachine.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace AST;
+
+namespace {
+
+AST::AST generateTree(size_t messages) {
+    auto arena = std::make_unique<Arena>();
+    auto* root = arena->create<Rules>(*arena);
+    for (size_t i = 0; i < messages; ++i) {
+        auto text = arena->copyString("Round " + std::to_string(i));
+        auto* format = arena->create<FormatNode>(*arena, text);
+        root->appendRule(arena->create<GlobalMessage>(*arena, format));
+    }
+    return AST::AST{std::move(arena), root};
+}
+
+// Counts messages instead of printing them, so that the benchmarks measure
+// dispatch rather than console output.
+class CountingCommunication : public Communication {
+    public:
+        virtual void sendGlobalMessage(std::string_view message) override {
+            ++sent;
+            benchmark::DoNotOptimize(message.data());
+        }
+        size_t sent = 0;
+};
+
+std::shared_ptr<const std::string> generateSpecification(size_t messages) {
+    std::string source = R"({"configuration": {"name": "Benchmark", "player count": {"min": 2, "max": 8}},)"
+                         R"( "variables": {"winners": []}, "rules": [)";
+    for (size_t i = 0; i < messages; ++i) {
+        source += i == 0 ? "\n" : ",\n";
+        source += R"(  {"rule": "global-message", "value": "Round )" + std::to_string(i) + "\"}";
+    }
+    source += "\n]}";
+    return std::make_shared<const std::string>(std::move(source));
+}
+
+DSLValue generateMap(size_t entries) {
+    Map map;
+    for (size_t i = 0; i < entries; ++i) {
+        map.emplace("player" + std::to_string(i), static_cast<int>(i));
+    }
+    return DSLValue{std::move(map)};
+}
+
+}
+
+static void BM_DSLValueCopy(benchmark::State& state) {
+    auto value = generateMap(state.range(0));
+    for (auto _ : state) {
+        DSLValue copy{value};
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK(BM_DSLValueCopy)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_DSLValueMove(benchmark::State& state) {
+    auto value = generateMap(state.range(0));
+    for (auto _ : state) {
+        DSLValue moved{std::move(value)};
+        value = std::move(moved);
+        benchmark::DoNotOptimize(value);
+    }
+}
+BENCHMARK(BM_DSLValueMove)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_DSLValueAccess(benchmark::State& state) {
+    auto value = generateMap(state.range(0));
+    std::string key = "player" + std::to_string(state.range(0) / 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(value[key].get<int>());
+    }
+}
+BENCHMARK(BM_DSLValueAccess)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_EnvironmentLookup(benchmark::State& state) {
+    Environment environment{nullptr};
+    std::vector<std::string> names;
+    for (int i = 0; i < state.range(0); ++i) {
+        names.push_back("variable" + std::to_string(i));
+        environment.setBinding(names.back(), DSLValue{i});
+    }
+    std::mt19937 random{42};
+    std::uniform_int_distribution<size_t> pick{0, names.size() - 1};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(environment.getValue(names[pick(random)]));
+    }
+}
+BENCHMARK(BM_EnvironmentLookup)->Arg(8)->Arg(64)->Arg(1024);
+
+static void BM_InterpreterTraversal(benchmark::State& state) {
+    auto tree = generateTree(state.range(0));
+    CountingCommunication communication;
+    Interpreter interpreter{Environment{nullptr}, communication};
+    for (auto _ : state) {
+        tree.accept(interpreter);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_InterpreterTraversal)->Arg(100)->Arg(10000)->Arg(100000);
+
+static void BM_VirtualMachine(benchmark::State& state) {
+    auto tree = generateTree(state.range(0));
+    auto program = Compiler{}.compile(tree);
+    CountingCommunication communication;
+    VirtualMachine machine{Environment{nullptr}, communication};
+    for (auto _ : state) {
+        machine.run(program);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VirtualMachine)->Arg(100)->Arg(10000)->Arg(100000);
+
+static void BM_Compile(benchmark::State& state) {
+    auto tree = generateTree(state.range(0));
+    for (auto _ : state) {
+        auto program = Compiler{}.compile(tree);
+        benchmark::DoNotOptimize(program);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Compile)->Arg(100)->Arg(10000)->Arg(100000);
+
+static void BM_GetChildrenTraversal(benchmark::State& state) {
+    auto tree = generateTree(state.range(0));
+    for (auto _ : state) {
+        size_t visited = 0;
+        for (auto* child : tree.getParent().getChildren()) {
+            visited += child->getChildren().size();
+        }
+        benchmark::DoNotOptimize(visited);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GetChildrenTraversal)->Arg(100)->Arg(10000)->Arg(100000);
+
+
+static void BM_TreeConstruction(benchmark::State& state) {
+    for (auto _ : state) {
+        auto tree = generateTree(state.range(0));
+        benchmark::DoNotOptimize(tree);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TreeConstruction)->Arg(100)->Arg(10000)->Arg(100000);
+
+// Starting a game of a type that is already cached costs a hash of the rules
+// source instead of a parse and a compile.
+static void BM_RuleCacheGameStart(benchmark::State& state) {
+    std::string source(state.range(0) * 32, 'x');
+    RuleCache cache;
+    CountingCommunication communication;
+    auto parse = [&] { return generateTree(state.range(0)); };
+    for (auto _ : state) {
+        GameRules game{cache.getOrParse(source, parse), communication};
+        benchmark::DoNotOptimize(game);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RuleCacheGameStart)->Arg(100)->Arg(10000)->Arg(100000);
+
+static void BM_StreamingParse(benchmark::State& state) {
+    auto source = generateSpecification(state.range(0));
+    for (auto _ : state) {
+        auto tree = ASTParser{std::make_unique<StreamingJSONParser>(source)}.parse();
+        benchmark::DoNotOptimize(tree);
+    }
+    state.SetBytesProcessed(state.iterations() * source->size());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StreamingParse)->Arg(100)->Arg(10000)->Arg(100000);
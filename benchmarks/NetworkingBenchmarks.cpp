@@ -0,0 +1,184 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "Client.h"
+#include "Server.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+using networking::Client;
+using networking::ClientContext;
+using networking::Connection;
+using networking::Message;
+using networking::ReceivedMessage;
+using networking::Server;
+
+
+namespace {
+
+
+constexpr unsigned short PORT = 4990;
+constexpr std::size_t PAYLOAD_BYTES = 128;
+
+
+// A Server on the loopback interface together with a number of connected
+// Clients that share one context.
+class Harness {
+public:
+  explicit Harness(std::size_t clientCount)
+    : server{PORT, "",
+             [this] (Connection c) { connections.push_back(c); },
+             [] (Connection) {}} {
+    for (std::size_t i = 0; i < clientCount; ++i) {
+      clients.push_back(std::make_unique<Client>(context, "localhost",
+                                                 std::to_string(PORT)));
+    }
+    while (connections.size() < clientCount) {
+      pump();
+    }
+  }
+
+  void
+  pump() {
+    server.update();
+    context.update();
+  }
+
+  // Run I/O until every outgoing queue is empty and the Clients have read
+  // everything that was written to them.
+  void
+  flush() {
+    while (0 < server.getMetrics().queuedMessages) {
+      pump();
+    }
+    drainClients();
+  }
+
+  void
+  drainClients() {
+    context.update();
+    for (auto& client : clients) {
+      client->receive(scratch);
+    }
+  }
+
+  Server server;
+  ClientContext context;
+  std::vector<std::unique_ptr<Client>> clients;
+  std::vector<Connection> connections;
+  std::vector<ReceivedMessage> scratch;
+};
+
+
+}
+
+
+// Server::send with one Message per recipient, each owning a copy of the text.
+static void
+BM_SendFanOut(benchmark::State& state) {
+  Harness harness{static_cast<std::size_t>(state.range(0))};
+  std::string payload(PAYLOAD_BYTES, 'x');
+
+  for (auto _ : state) {
+    std::deque<Message> outgoing;
+    for (auto connection : harness.connections) {
+      outgoing.push_back({connection, payload});
+    }
+    harness.server.send(outgoing);
+    harness.server.update();
+
+    state.PauseTiming();
+    harness.flush();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SendFanOut)->Arg(10)->Arg(100)->Arg(500);
+
+
+// Server::broadcast sharing a single payload across all recipients.
+static void
+BM_BroadcastFanOut(benchmark::State& state) {
+  Harness harness{static_cast<std::size_t>(state.range(0))};
+  std::string payload(PAYLOAD_BYTES, 'x');
+
+  for (auto _ : state) {
+    harness.server.broadcast(std::make_shared<const std::string>(payload),
+                             harness.connections);
+    harness.server.update();
+
+    state.PauseTiming();
+    harness.flush();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BroadcastFanOut)->Arg(10)->Arg(100)->Arg(500);
+
+
+// Server::receive taking a batch of already received messages, reusing the
+// same vector every time.
+static void
+BM_ReceiveDrain(benchmark::State& state) {
+  auto batchSize = static_cast<std::size_t>(state.range(0));
+  Harness harness{10};
+  std::string payload(PAYLOAD_BYTES, 'x');
+  std::vector<Message> incoming;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto target = harness.server.getMetrics().messagesIn + batchSize;
+    for (std::size_t i = 0; i < batchSize; ++i) {
+      harness.clients[i % harness.clients.size()]->send(payload);
+    }
+    while (harness.server.getMetrics().messagesIn < target) {
+      harness.pump();
+    }
+    state.ResumeTiming();
+
+    harness.server.receive(incoming);
+    benchmark::DoNotOptimize(incoming.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(BM_ReceiveDrain)->Arg(10)->Arg(100)->Arg(1000);
+
+
+// Queueing a burst of messages to a single Channel and writing them out.
+static void
+BM_WriteQueueChurn(benchmark::State& state) {
+  auto burst = static_cast<std::size_t>(state.range(0));
+  Harness harness{1};
+  auto connection = harness.connections.front();
+  auto payload = std::make_shared<const std::string>(PAYLOAD_BYTES, 'x');
+  std::vector<Connection> recipient{connection};
+
+  for (auto _ : state) {
+    // broadcast() only posts to the Channel's strand, so the queue may still
+    // look empty here. Wait until every message has actually been written.
+    auto target = harness.server.getMetrics().messagesOut + burst;
+    for (std::size_t i = 0; i < burst; ++i) {
+      harness.server.broadcast(payload, recipient);
+    }
+    while (harness.server.getMetrics().messagesOut < target) {
+      harness.server.update();
+    }
+
+    state.PauseTiming();
+    harness.drainClients();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_WriteQueueChurn)->Arg(1)->Arg(16)->Arg(256);
+
@@ -9,13 +9,77 @@
 #ifndef NETWORKING_CLIENT_H
 #define NETWORKING_CLIENT_H
 
+#include "Compression.h"
+#include "MessageType.h"
+
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 
 namespace networking {
 
 
+/**
+ *  Tuning options for a Client.
+ */
+struct ClientOptions {
+  /** Settings for compressing websocket messages. See CompressionOptions. */
+  CompressionOptions compression;
+};
+
+
+/**
+ *  A single message received by a Client. For BINARY messages, `text` holds
+ *  the raw bytes of the payload.
+ */
+struct ReceivedMessage {
+  std::string text;
+  MessageType type = MessageType::TEXT;
+};
+
+
+/**
+ *  @class ClientContext
+ *
+ *  @brief An I/O context that many Client instances can share.
+ *
+ *  Every Client normally owns its own I/O context. Clients constructed with a
+ *  ClientContext instead share one, so a single thread can drive thousands of
+ *  connections, e.g. for bots or load testing. Calling update() on the
+ *  context or on any Client that uses it performs the pending sends and
+ *  receives of all of them. The context must outlive its Clients.
+ */
+class ClientContext {
+public:
+  ClientContext();
+
+  /** Out of line default constructor for compilation firewall. */
+  ~ClientContext();
+
+  /**
+   *  Perform all pending sends and receives for every Client using this
+   *  context. This can throw if any of the I/O operations encounters an
+   *  error.
+   */
+  void update();
+
+  /**
+   *  Block for at most the given duration performing sends and receives as
+   *  they become ready, for every Client using this context.
+   */
+  void updateFor(std::chrono::microseconds timeout);
+
+private:
+  friend class Client;
+  class ContextImpl;
+
+  std::unique_ptr<ContextImpl> impl;
+};
+
+
 /**
  *  @class Client
  *
@@ -33,7 +97,19 @@ public:
    *  Construct a Client and acquire a connection to a remote Server at the
    *  given address and port.
    */
-  Client(std::string_view address, std::string_view port);
+  Client(std::string_view address,
+         std::string_view port,
+         ClientOptions options = {});
+
+  /**
+   *  Construct a Client that performs its I/O using the given shared
+   *  ClientContext and acquire a connection to a remote Server at the given
+   *  address and port.
+   */
+  Client(ClientContext& context,
+         std::string_view address,
+         std::string_view port,
+         ClientOptions options = {});
 
   /** Out of line default constructor for compilation firewall. */
   ~Client();
@@ -45,24 +121,56 @@ public:
   void update();
 
   /**
-   *  Send a message to the server.
+   *  Send a message to the server. BINARY messages carry the raw bytes of the
+   *  given string.
    */
-  void send(std::string message);
+  void send(std::string message, MessageType type = MessageType::TEXT);
 
   /**
-   *  Receive messages from the Server. This returns all messages collected by
-   *  previous calls to Client::update() and not yet received. If multiple
-   *  messages were received from the Server, they are first concatenated
-   *  into a single std::string.
+   *  Receive text messages from the Server. This returns all text messages
+   *  collected by previous calls to Client::update() and not yet received. If
+   *  multiple messages were received from the Server, they are first
+   *  concatenated into a single std::string.
    */
   [[nodiscard]] std::string receive();
 
+  /**
+   *  Receive binary messages from the Server. Unlike text, binary messages
+   *  are not concatenated, so each payload is returned separately in the
+   *  order it arrived.
+   */
+  [[nodiscard]] std::deque<std::string> receiveBinary();
+
+  /**
+   *  Receive every message from the Server, text and binary, into the given
+   *  vector, replacing its contents. Each message is kept separate and in the
+   *  order it arrived. The messages previously held by the vector are
+   *  recycled, so passing the same vector to every call reuses both the
+   *  vector and the storage of the message texts.
+   */
+  void receive(std::vector<ReceivedMessage>& messages);
+
   /**
    *  Returns true iff the client disconnected from the server after initially
    *  connecting.
    */
   [[nodiscard]] bool isDisconnected() const noexcept;
 
+  /**
+   *  Drop the current connection, if any, and connect to the Server again.
+   *  If the Server has sessions enabled and still holds this Client's
+   *  session, the new connection resumes it. The Server then keeps the same
+   *  Connection for this Client and replays the messages that it missed.
+   *  Messages that were not yet fully written are sent again.
+   */
+  void reconnect();
+
+  /**
+   *  Returns true iff the most recent connection resumed an earlier session
+   *  rather than starting a new one. See Client::reconnect().
+   */
+  [[nodiscard]] bool wasResumed() const noexcept;
+
 private:
   class ClientImpl;
 
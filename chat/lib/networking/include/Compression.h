@@ -0,0 +1,43 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_COMPRESSION_H
+#define NETWORKING_COMPRESSION_H
+
+
+namespace networking {
+
+
+/**
+ *  Settings for the websocket permessage-deflate extension (RFC 7692). The
+ *  extension is only used when both ends enable it, so enabling it on only a
+ *  Server or only a Client is always safe.
+ */
+struct CompressionOptions {
+  /** Whether to offer (Client) or accept (Server) permessage-deflate. */
+  bool enabled = false;
+
+  /** The deflate compression level, from 0 (fastest) to 9 (smallest). */
+  int level = 6;
+
+  /**
+   *  The base two logarithm of the deflate window size, from 9 to 15.
+   *  Smaller windows use less memory per connection but compress worse.
+   */
+  int windowBits = 15;
+
+  /** The deflate memory level, from 1 to 9. */
+  int memoryLevel = 4;
+};
+
+
+}
+
+
+#endif
+
@@ -0,0 +1,33 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_MESSAGE_TYPE_H
+#define NETWORKING_MESSAGE_TYPE_H
+
+#include <cstdint>
+
+
+namespace networking {
+
+
+/**
+ *  The kind of websocket message that carries a payload. TEXT payloads must
+ *  be valid UTF-8, while BINARY payloads are arbitrary bytes that are
+ *  transferred without any escaping or encoding.
+ */
+enum class MessageType : uint8_t {
+  TEXT,
+  BINARY,
+};
+
+
+}
+
+
+#endif
+
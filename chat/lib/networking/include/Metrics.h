@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_METRICS_H
+#define NETWORKING_METRICS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+namespace networking {
+
+
+/**
+ *  A histogram of latencies. Bucket i counts the latencies that took fewer
+ *  than 2^i microseconds but at least 2^(i-1) microseconds. The final bucket
+ *  also collects everything slower.
+ */
+struct LatencyHistogram {
+  static constexpr std::size_t BUCKET_COUNT = 26;
+
+  std::array<uint64_t, BUCKET_COUNT> buckets{};
+  uint64_t count = 0;
+  uint64_t totalMicroseconds = 0;
+
+  /**
+   *  Return an upper bound on the given percentile (in [0, 1]) of the
+   *  recorded latencies, or 0 if nothing has been recorded.
+   */
+  [[nodiscard]] std::chrono::microseconds percentile(double fraction) const;
+};
+
+
+/**
+ *  A snapshot of the activity of a Server since it was constructed. The
+ *  counters only grow, so rates can be computed from successive snapshots.
+ */
+struct ServerMetrics {
+  uint64_t httpRequests = 0;
+  uint64_t connectionsOpened = 0;
+  uint64_t connectionsClosed = 0;
+  uint64_t connectionsActive = 0;
+  // Connections closed by the Server for exceeding ServerOptions::idleTimeout.
+  uint64_t connectionsTimedOut = 0;
+  // Connections that dropped and were later resumed by their Client.
+  uint64_t sessionsResumed = 0;
+
+  uint64_t messagesIn = 0;
+  uint64_t messagesOut = 0;
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+  // Bytes on the wire, including websocket framing and after compression.
+  uint64_t wireBytesIn = 0;
+  uint64_t wireBytesOut = 0;
+  uint64_t messagesDropped = 0;
+  // Incoming messages discarded or delayed for exceeding RateLimits.
+  uint64_t messagesRejected = 0;
+  uint64_t readsThrottled = 0;
+  uint64_t errors = 0;
+
+  // Data waiting in outgoing queues across all connections at snapshot time.
+  uint64_t queuedMessages = 0;
+  uint64_t queuedBytes = 0;
+
+  /**
+   *  The ratio of outgoing message bytes to the bytes actually written to
+   *  the wire. Values above 1 reflect savings from compression.
+   */
+  [[nodiscard]] double
+  compressionRatio() const noexcept {
+    return wireBytesOut == 0
+      ? 1.0
+      : static_cast<double>(bytesOut) / static_cast<double>(wireBytesOut);
+  }
+
+  /** From accepting a TCP connection until its websocket is registered. */
+  LatencyHistogram accept;
+  /** How long received messages wait before Server::receive() takes them. */
+  LatencyHistogram read;
+  /** From starting a websocket write until it completes. */
+  LatencyHistogram write;
+  /** Time spent running handlers within Server::update() and friends. */
+  LatencyHistogram update;
+};
+
+
+/**
+ *  Render the metrics in the Prometheus text exposition format.
+ */
+[[nodiscard]] std::string formatMetrics(const ServerMetrics& metrics);
+
+
+}
+
+
+#endif
+
@@ -0,0 +1,138 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_ROOM_MANAGER_H
+#define NETWORKING_ROOM_MANAGER_H
+
+#include "Server.h"
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+
+namespace networking {
+
+
+/**
+ *  An identifier for a room, e.g. a single instance of a game.
+ */
+using RoomId = uint64_t;
+
+
+/**
+ *  @class RoomManager
+ *
+ *  @brief Tracks which Connections belong to which rooms.
+ *
+ *  Each Connection is in at most one room at a time. Joining and leaving are
+ *  O(1), and the members of a room are kept contiguous so that broadcasting
+ *  to a room is a single pass over a vector.
+ *
+ *  Rooms are partitioned into shards by RoomId, and each shard has its own
+ *  lock, so rooms on different shards can be processed in parallel from
+ *  different threads. Operations on a single Connection should come from one
+ *  thread at a time.
+ */
+class RoomManager {
+public:
+  /**
+   *  Construct a RoomManager with the given number of shards. With 0, one
+   *  shard is used per hardware thread.
+   */
+  explicit RoomManager(std::size_t shardCount = 0);
+
+  /**
+   *  Move the Connection into the given room, first leaving any room that it
+   *  is currently in.
+   */
+  void join(Connection connection, RoomId room);
+
+  /**
+   *  Remove the Connection from its room, if it is in one.
+   */
+  void leave(Connection connection);
+
+  /**
+   *  Return the room containing the Connection, if any.
+   */
+  [[nodiscard]] std::optional<RoomId> getRoom(Connection connection) const;
+
+  /**
+   *  Return a copy of the members of the given room.
+   */
+  [[nodiscard]] std::vector<Connection> getMembers(RoomId room) const;
+
+  /**
+   *  Return the number of members in the given room without copying them.
+   */
+  [[nodiscard]] std::size_t getMemberCount(RoomId room) const;
+
+  /**
+   *  Send the text to every member of the given room.
+   */
+  void broadcast(Server& server,
+                 RoomId room,
+                 SharedText text,
+                 MessageType type = MessageType::TEXT) const;
+
+  [[nodiscard]] std::size_t getShardCount() const noexcept { return roomShards.size(); }
+
+  /** Return the index of the shard that holds the given room. */
+  [[nodiscard]] std::size_t getShard(RoomId room) const noexcept;
+
+  /**
+   *  Call `visit(RoomId, const std::vector<Connection>&)` for every nonempty
+   *  room in the given shard. Only that shard is locked while visiting, so
+   *  the visitor must not join or leave rooms in the same shard.
+   */
+  template <typename Visitor>
+  void
+  forEachRoom(std::size_t shard, Visitor&& visit) const {
+    auto& roomShard = roomShards[shard];
+    std::lock_guard lock{roomShard.lock};
+    for (auto& [id, room] : roomShard.rooms) {
+      visit(id, static_cast<const std::vector<Connection>&>(room.members));
+    }
+  }
+
+private:
+  struct Room {
+    std::vector<Connection> members;
+    // The index of each member within `members`, for O(1) removal.
+    std::unordered_map<Connection, std::size_t, ConnectionHash> positions;
+  };
+
+  struct RoomShard {
+    mutable std::mutex lock;
+    std::unordered_map<RoomId, Room> rooms;
+  };
+
+  struct ConnectionShard {
+    mutable std::mutex lock;
+    std::unordered_map<Connection, RoomId, ConnectionHash> rooms;
+  };
+
+  [[nodiscard]] ConnectionShard& getConnectionShard(Connection connection) const;
+  void removeMember(Connection connection, RoomId room);
+  void addMember(Connection connection, RoomId room);
+
+  // NOTE: To avoid deadlock, a connection shard is always locked before a
+  // room shard, and at most one of each is held at a time.
+  mutable std::vector<RoomShard> roomShards;
+  mutable std::vector<ConnectionShard> connectionShards;
+};
+
+
+}
+
+
+#endif
+
@@ -9,11 +9,19 @@
 #ifndef NETWORKING_SERVER_H
 #define NETWORKING_SERVER_H
 
+#include "Compression.h"
+#include "MessageType.h"
+#include "Metrics.h"
+#include "TimerWheel.h"
+
+#include <chrono>
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 
 namespace networking {
@@ -22,9 +30,11 @@ namespace networking {
 /**
  *  An identifier for a Client connected to a Server. The ID of a Connection is
  *  guaranteed to be unique across all actively connected Client instances.
+ *  IDs are reused only rarely, so the ID of a Connection that has since
+ *  disconnected is safely ignored rather than reaching a newer Client.
  */
 struct Connection {
-  uintptr_t id;
+  uint64_t id;
 
   bool
   operator==(Connection other) const {
@@ -43,11 +53,205 @@ struct ConnectionHash {
 
 /**
  *  A Message containing text that can be sent to or was recieved from a given
- *  Connection.
+ *  Connection. For BINARY messages, `text` holds the raw bytes of the payload.
  */
 struct Message {
   Connection connection;
   std::string text;
+  MessageType type = MessageType::TEXT;
+};
+
+
+/**
+ *  An immutable, reference counted message body. A single SharedText can be
+ *  queued for any number of Connections without copying its contents.
+ */
+using SharedText = std::shared_ptr<const std::string>;
+
+
+/**
+ *  Limits on the outgoing queue of a single Connection, in queued messages
+ *  and in queued bytes. When either high watermark is exceeded, the Server's
+ *  OverflowPolicy is applied. Policies that discard messages shrink the queue
+ *  down to the low watermarks. A high watermark of 0 means unlimited, and a
+ *  low watermark of 0 means the same as its high watermark.
+ */
+struct QueueLimits {
+  std::size_t highWaterMessages = 0;
+  std::size_t highWaterBytes = 0;
+  std::size_t lowWaterMessages = 0;
+  std::size_t lowWaterBytes = 0;
+};
+
+
+/**
+ *  What a Server does when the outgoing queue of a Connection exceeds its
+ *  QueueLimits, e.g. because the Client is on a slow or stalled link.
+ */
+enum class OverflowPolicy {
+  /** Discard the oldest queued messages until the low watermarks are met. */
+  DROP_OLDEST,
+  /** Discard everything but the newest message, e.g. for state snapshots. */
+  KEEP_LATEST,
+  /** Disconnect the Connection. */
+  DISCONNECT,
+};
+
+
+/**
+ *  Limits on how fast a single Connection may send messages to the Server.
+ *  Each limit is a token bucket that refills at the given rate and holds at
+ *  most the given burst. A rate of 0 means unlimited, and a burst of 0 means
+ *  one second's worth of the rate.
+ */
+struct RateLimits {
+  double messagesPerSecond = 0;
+  std::size_t burstMessages = 0;
+  double bytesPerSecond = 0;
+  std::size_t burstBytes = 0;
+};
+
+
+/**
+ *  What a Server does with messages from a Connection that exceeds its
+ *  RateLimits.
+ */
+enum class FloodPolicy {
+  /** Discard messages until the Connection is back under its limits. */
+  DROP,
+  /** Accept the message but stop reading from the Connection until it is
+   *  back under its limits. This applies backpressure through TCP. */
+  THROTTLE,
+  /** Disconnect the Connection. */
+  DISCONNECT,
+};
+
+
+/**
+ *  The amount of data waiting to be written to a Connection.
+ */
+struct QueueDepth {
+  std::size_t messages = 0;
+  std::size_t bytes = 0;
+};
+
+
+/**
+ *  Settings for resuming the sessions of Clients whose connections drop.
+ *  When enabled, every Connection is issued a session token during the
+ *  websocket handshake. A Client that reconnects with its token before the
+ *  retention period ends keeps its Connection, and the messages that it
+ *  missed are replayed instead of lost. The disconnect callback is only
+ *  called once a session ends. Messages to resumable Connections are never
+ *  coalesced, so ServerOptions::maxWriteBatch does not apply to them.
+ *
+ *  The token is sent in the `X-Session-Token` header of the handshake
+ *  response, which browsers do not expose to scripts. Resuming is therefore
+ *  limited to native clients such as networking::Client. A Client whose
+ *  session cannot be resumed is sent a new token and starts over.
+ */
+struct SessionOptions {
+  bool enabled = false;
+
+  /** How many recent messages per Connection can be replayed. */
+  std::size_t replayCapacity = 256;
+
+  /** How long a dropped Connection waits for its Client to return. */
+  std::chrono::milliseconds retention{30000};
+};
+
+
+/**
+ *  Tuning options for a Server. The defaults preserve the original single
+ *  threaded behavior in which all I/O happens inside Server::update().
+ */
+struct ServerOptions {
+  /**
+   *  The number of background threads that drive network I/O. When 0, all
+   *  I/O is performed on the thread calling Server::update(). Otherwise, the
+   *  given number of threads run the I/O for all connections, and
+   *  Server::update() only delivers connect and disconnect notifications.
+   *  Connections are only given strands of their own when there is more than
+   *  one thread, since a single thread already runs their handlers in order.
+   */
+  unsigned ioThreads = 0;
+
+  /**
+   *  The maximum number of queued messages to a single Connection that may be
+   *  coalesced into one websocket message. Coalescing cuts the number of
+   *  frames and system calls under bursty traffic, but the receiver sees the
+   *  coalesced texts concatenated into a single message, so it should only
+   *  be enabled when messages are self delimiting (e.g. newline terminated).
+   *  Only consecutive TEXT messages are coalesced; BINARY messages are always
+   *  sent individually. The default of 1 sends every message as its own
+   *  websocket message.
+   */
+  std::size_t maxWriteBatch = 1;
+
+  /**
+   *  The default limits on every Connection's outgoing queue. These can be
+   *  overridden per Connection via Server::setQueueLimits().
+   */
+  QueueLimits queueLimits;
+
+  /** The initial policy for Connections that exceed their QueueLimits. */
+  OverflowPolicy overflowPolicy = OverflowPolicy::DROP_OLDEST;
+
+  /**
+   *  Whether to answer HTTP requests for `/metrics` with the Server's metrics
+   *  in the Prometheus text format. See Server::getMetrics().
+   */
+  bool serveMetrics = false;
+
+  /**
+   *  A directory of static assets to serve over HTTP, e.g. the scripts,
+   *  styles, and images of a web client. Every file beneath it is loaded into
+   *  memory once when the Server is constructed and served at its relative
+   *  path. Sibling files ending in `.gz` or `.br` are served as precompressed
+   *  variants to clients that accept them. Empty disables asset serving.
+   */
+  std::string assetDirectory;
+
+  /**
+   *  The default limits on how fast every Connection may send. These can be
+   *  overridden per Connection via Server::setRateLimits().
+   */
+  RateLimits rateLimits;
+
+  /** How Connections that exceed their RateLimits are handled. */
+  FloodPolicy floodPolicy = FloodPolicy::DROP;
+
+  /**
+   *  The largest message in bytes that a Client may send. Larger messages
+   *  close the Connection with a "message too big" status. 0 uses the
+   *  websocket library's default of 16 MiB.
+   */
+  std::size_t maxMessageSize = 0;
+
+  /** Settings for compressing websocket messages. See CompressionOptions. */
+  CompressionOptions compression;
+
+  /** Settings for resuming dropped Connections. See SessionOptions. */
+  SessionOptions sessions;
+
+  /**
+   *  How long a Connection may go without sending anything before the Server
+   *  disconnects it. Once half of this has passed quietly, the Server pings
+   *  the Client, so live Clients stay connected while half-open connections
+   *  are evicted. 0 disables idle eviction.
+   */
+  std::chrono::milliseconds idleTimeout{0};
+};
+
+
+/**
+ *  The outcome of Server::drain(). Connections are closed cleanly when all
+ *  of their queued messages were written and the websocket close handshake
+ *  completed before the timeout. The rest are forcibly closed.
+ */
+struct DrainResult {
+  std::size_t closedCleanly = 0;
+  std::size_t forced = 0;
 };
 
 
@@ -62,13 +266,19 @@ struct ServerImplDeleter {
 /**
  *  @class Server
  *
- *  @brief A single threaded network server for transferring text.
+ *  @brief A network server for transferring text.
  *
  *  The Server class transfers text to and from multiple Client instances
- *  connected on a given port. The behavior is single threaded, so all transfer
- *  operations are grouped and performed on the next call to Server::update().
- *  Text can be sent to the Server using Client::send() and received from the
- *  Server using Client::receive().
+ *  connected on a given port. By default the behavior is single threaded, so
+ *  all transfer operations are grouped and performed on the next call to
+ *  Server::update(). Text can be sent to the Server using Client::send() and
+ *  received from the Server using Client::receive().
+ *
+ *  When ServerOptions::ioThreads is nonzero, a pool of threads performs the
+ *  transfers in the background instead. Server::send(), Server::receive(),
+ *  and Server::disconnect() remain safe to call from the thread that owns the
+ *  Server, and the connect and disconnect callbacks are still only invoked on
+ *  that thread from within Server::update() and Server::receive().
  *
  *  The Server is websocket based and supports sending a single file back in
  *  response to HTTP requests for `index.html`. This allows command line and
@@ -91,27 +301,90 @@ public:
    *
    *  The httpMessage is a string containing HTML content that will be sent
    *  in response to standard HTTP requests for any path ending in `index.html`.
+   *  Other paths are served from ServerOptions::assetDirectory, if given.
+   *
+   *  The options configure how the Server performs I/O. See ServerOptions.
    */
   template <typename C, typename D>
   Server(unsigned short port,
          std::string httpMessage,
          C onConnect,
-         D onDisconnect)
+         D onDisconnect,
+         ServerOptions options = {})
     : connectionHandler{std::make_unique<ConnectionHandlerImpl<C,D>>(onConnect, onDisconnect)},
-      impl{buildImpl(*this, port, std::move(httpMessage))}
+      impl{buildImpl(*this, port, std::move(httpMessage), options)}
       { }
 
   /**
    *  Perform all pending sends and receives. This function can throw an
-   *  exception if any of the I/O operations encounters an error.
+   *  exception if any of the I/O operations encounters an error. When I/O is
+   *  performed by background threads, this only delivers pending connect and
+   *  disconnect notifications.
    */
   void update();
 
+  /**
+   *  Block until at least one Message has been received, a Connection has
+   *  opened or closed, a timer is due, or the deadline passes, whichever
+   *  comes first, and then perform all other pending sends and receives.
+   *  This allows a game loop to sleep while idle and still wake as soon as a
+   *  Client connects or sends something. Like
+   *  Server::update(), this can throw if any of the I/O operations encounters
+   *  an error.
+   */
+  void updateUntil(std::chrono::steady_clock::time_point deadline);
+
+  /**
+   *  Block for at most the given duration waiting for messages. See
+   *  Server::updateUntil().
+   */
+  template <typename Rep, typename Period>
+  void
+  updateFor(std::chrono::duration<Rep,Period> timeout) {
+    updateUntil(std::chrono::steady_clock::now() + timeout);
+  }
+
+  /**
+   *  Call the callback once the deadline has passed, e.g. for a turn timer.
+   *  Timers fire on the thread that owns the Server from within
+   *  Server::update() and Server::updateUntil(), with millisecond
+   *  resolution. Scheduling and cancelling a timer are O(1).
+   */
+  TimerHandle addTimer(std::chrono::steady_clock::time_point deadline,
+                       std::function<void()> callback);
+
+  /**
+   *  Call the callback once the given delay has passed. See
+   *  Server::addTimer().
+   */
+  template <typename Rep, typename Period>
+  TimerHandle
+  addTimer(std::chrono::duration<Rep,Period> delay, std::function<void()> callback) {
+    return addTimer(std::chrono::steady_clock::now() + delay, std::move(callback));
+  }
+
+  /**
+   *  Stop a timer from firing. Returns false if it already fired or was
+   *  cancelled.
+   */
+  bool cancelTimer(TimerHandle handle);
+
   /**
    *  Send a list of messages to their respective Clients.
    */
   void send(const std::deque<Message>& messages);
 
+  /**
+   *  Send the same text to every one of the given Connections. The text is
+   *  shared by all of the outgoing queues rather than copied. Without I/O
+   *  threads it is queued for each Connection directly, and with a single
+   *  I/O thread one handler queues it for all of them. With several I/O
+   *  threads each Connection's strand is posted to separately.
+   */
+  void broadcast(SharedText text,
+                 const std::vector<Connection>& connections,
+                 MessageType type = MessageType::TEXT);
+
   /**
    *  Receive Message instances from Client instances. This returns all Message
    *  instances collected by previous calls to Server::update() and not yet
@@ -119,11 +392,57 @@ public:
    */
   [[nodiscard]] std::deque<Message> receive();
 
+  /**
+   *  Receive Message instances from Client instances into the given vector,
+   *  replacing its contents. The Message instances previously held by the
+   *  vector are recycled, so the storage of their text is reused for future
+   *  messages. Passing the same vector to every call makes steady state
+   *  receiving free of allocations.
+   */
+  void receive(std::vector<Message>& messages);
+
   /**
    *  Disconnect the Client specified by the given Connection.
    */
   void disconnect(Connection connection);
 
+  /**
+   *  Gracefully shut down every Connection, e.g. before a restart. The
+   *  Server stops accepting new Connections, writes everything already
+   *  queued, and then closes each websocket with a close frame. Connections
+   *  that have not finished within the timeout are forcibly closed. The
+   *  disconnect callback is called for every Connection before returning.
+   */
+  DrainResult drain(std::chrono::steady_clock::duration timeout);
+
+  /**
+   *  Return how much data is currently waiting to be written to the given
+   *  Connection. Unknown Connections have an empty queue.
+   */
+  [[nodiscard]] QueueDepth getQueueDepth(Connection connection) const;
+
+  /**
+   *  Replace the outgoing QueueLimits of a single Connection.
+   */
+  void setQueueLimits(Connection connection, QueueLimits limits);
+
+  /**
+   *  Replace the incoming RateLimits of a single Connection, e.g. to trust a
+   *  game host more than its players.
+   */
+  void setRateLimits(Connection connection, RateLimits limits);
+
+  /**
+   *  Change how Connections that exceed their QueueLimits are handled.
+   */
+  void setOverflowPolicy(OverflowPolicy policy);
+
+  /**
+   *  Return a snapshot of the Server's counters and latency histograms. This
+   *  is cheap enough to call every tick.
+   */
+  [[nodiscard]] ServerMetrics getMetrics() const;
+
 private:
   friend class ServerImpl;
 
@@ -154,7 +473,10 @@ private:
   };
 
   static std::unique_ptr<ServerImpl,ServerImplDeleter>
-  buildImpl(Server& server, unsigned short port, std::string httpMessage);
+  buildImpl(Server& server,
+            unsigned short port,
+            std::string httpMessage,
+            ServerOptions options);
 
   std::unique_ptr<ConnectionHandler> connectionHandler;
   std::unique_ptr<ServerImpl,ServerImplDeleter> impl;
@@ -0,0 +1,129 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_TIMER_WHEEL_H
+#define NETWORKING_TIMER_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+
+namespace networking {
+
+
+/**
+ *  Identifies a timer scheduled on a TimerWheel. A default constructed
+ *  handle never refers to a timer, and a handle stops referring to its timer
+ *  once the timer fires or is cancelled.
+ */
+struct TimerHandle {
+  uint32_t index = 0;
+  uint32_t generation = 0;
+};
+
+
+/**
+ *  @class TimerWheel
+ *
+ *  @brief A hierarchical timing wheel with millisecond resolution.
+ *
+ *  Timers are kept in four levels of 256 slots each. The first level holds
+ *  timers due within 256 ms, one slot per millisecond, and every further level
+ *  covers 256 times the span of the one below. As time advances, the timers
+ *  in a slot of a higher level are redistributed into the lower levels.
+ *  Scheduling and cancelling are O(1), and timers live in a pooled array, so
+ *  millions of them can be outstanding at once.
+ *
+ *  A TimerWheel is not thread safe. Callbacks run inside advance() and may
+ *  schedule or cancel timers themselves.
+ */
+class TimerWheel {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+
+  explicit TimerWheel(Clock::time_point start = Clock::now());
+
+  /**
+   *  Call the callback once the deadline has passed. Deadlines are rounded up
+   *  to the next millisecond, and deadlines in the past fire on the next
+   *  advance().
+   */
+  TimerHandle schedule(Clock::time_point deadline, Callback callback);
+
+  /**
+   *  Stop the given timer from firing. Returns false if the timer has already
+   *  fired or been cancelled.
+   */
+  bool cancel(TimerHandle handle);
+
+  /**
+   *  Fire every timer whose deadline is at or before `now`, returning the
+   *  number of callbacks called.
+   */
+  std::size_t advance(Clock::time_point now);
+
+  /**
+   *  Return a time at or before the earliest pending deadline, or nothing if
+   *  no timers are pending. Advancing the wheel at this time will either fire
+   *  a timer or make progress toward one.
+   */
+  [[nodiscard]] std::optional<Clock::time_point> getNextExpiry() const;
+
+  /** Return the number of pending timers. */
+  [[nodiscard]] std::size_t size() const noexcept { return pending; }
+
+private:
+  static constexpr unsigned LEVEL_COUNT = 4;
+  static constexpr unsigned SLOT_BITS = 8;
+  static constexpr unsigned SLOT_COUNT = 1u << SLOT_BITS;
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+  struct Node {
+    Callback callback;
+    uint64_t expiry = 0;
+    uint32_t previous = NONE;
+    uint32_t next = NONE;
+    uint32_t generation = 1;
+    uint8_t level = 0;
+    uint8_t slot = 0;
+    bool active = false;
+  };
+
+  struct Level {
+    std::array<uint32_t, SLOT_COUNT> heads;
+    std::array<uint64_t, SLOT_COUNT / 64> occupied{};
+  };
+
+  [[nodiscard]] uint64_t toTick(Clock::time_point time) const;
+  [[nodiscard]] Clock::time_point toTime(uint64_t tick) const;
+  void link(uint32_t index);
+  void unlink(uint32_t index);
+  void release(uint32_t index);
+  void cascade(unsigned level);
+  [[nodiscard]] std::optional<uint64_t> getNextEventTick() const;
+  std::size_t fireCurrentSlot();
+
+  Clock::time_point start;
+  uint64_t currentTick = 0;
+  std::size_t pending = 0;
+  std::array<Level, LEVEL_COUNT> levels;
+  std::vector<Node> nodes;
+  uint32_t freeList = NONE;
+};
+
+
+}
+
+
+#endif
+
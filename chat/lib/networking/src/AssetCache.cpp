@@ -0,0 +1,242 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "AssetCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+
+using networking::Asset;
+using networking::AssetCache;
+using networking::AssetVariant;
+namespace fs = std::filesystem;
+
+
+namespace {
+
+
+std::string
+readFile(const fs::path& path) {
+  std::ifstream infile{path, std::ios::binary};
+  return std::string{std::istreambuf_iterator<char>(infile),
+                     std::istreambuf_iterator<char>()};
+}
+
+
+// A strong entity tag derived from the content (64 bit FNV-1a), so that tags
+// stay stable across restarts as long as the files do not change.
+std::string
+computeETag(const std::string& contents) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : contents) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  char buffer[21];
+  std::snprintf(buffer, sizeof(buffer), "\"%016llx\"",
+                static_cast<unsigned long long>(hash));
+  return buffer;
+}
+
+
+AssetVariant
+makeVariant(std::string contents) {
+  auto etag = computeETag(contents);
+  return {std::make_shared<const std::string>(std::move(contents)),
+          std::move(etag)};
+}
+
+
+std::string
+getContentType(const fs::path& path) {
+  static const std::unordered_map<std::string, std::string> types = {
+    {".html", "text/html"},
+    {".htm",  "text/html"},
+    {".css",  "text/css"},
+    {".js",   "application/javascript"},
+    {".mjs",  "application/javascript"},
+    {".json", "application/json"},
+    {".map",  "application/json"},
+    {".txt",  "text/plain"},
+    {".svg",  "image/svg+xml"},
+    {".png",  "image/png"},
+    {".jpg",  "image/jpeg"},
+    {".jpeg", "image/jpeg"},
+    {".gif",  "image/gif"},
+    {".ico",  "image/x-icon"},
+    {".webp", "image/webp"},
+    {".wasm", "application/wasm"},
+    {".woff", "font/woff"},
+    {".woff2", "font/woff2"},
+  };
+  auto found = types.find(path.extension().string());
+  return types.end() == found ? "application/octet-stream" : found->second;
+}
+
+
+bool
+equalsIgnoringCase(std::string_view a, std::string_view b) {
+  return a.size() == b.size()
+    && std::equal(a.begin(), a.end(), b.begin(), [] (char x, char y) {
+      return std::tolower(static_cast<unsigned char>(x))
+          == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+
+std::string_view
+trim(std::string_view text) {
+  auto first = text.find_first_not_of(" \t");
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  auto last = text.find_last_not_of(" \t");
+  return text.substr(first, last - first + 1);
+}
+
+
+// A q-value is at most three decimals, so it is zero exactly when it has no
+// nonzero digit. Missing q-values default to 1.
+bool
+hasNonzeroQuality(std::string_view parameters) {
+  std::size_t start = 0;
+  while (start < parameters.size()) {
+    auto end = std::min(parameters.find(';', start), parameters.size());
+    auto parameter = trim(parameters.substr(start, end - start));
+    auto equals = parameter.find('=');
+    if (equals != std::string_view::npos
+        && equalsIgnoringCase(trim(parameter.substr(0, equals)), "q")) {
+      auto value = trim(parameter.substr(equals + 1));
+      return value.find_first_of("123456789") != std::string_view::npos;
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+
+// Whether the Accept-Encoding header allows the coding. An explicit entry for
+// the coding takes precedence over the `*` wildcard, and q=0 refuses it.
+bool
+accepts(std::string_view acceptEncoding, std::string_view coding) {
+  std::optional<bool> wildcard;
+  std::size_t start = 0;
+  while (start < acceptEncoding.size()) {
+    auto end = std::min(acceptEncoding.find(',', start), acceptEncoding.size());
+    auto item = acceptEncoding.substr(start, end - start);
+    auto separator = std::min(item.find(';'), item.size());
+    auto name = trim(item.substr(0, separator));
+    auto parameters = item.substr(separator);
+    if (equalsIgnoringCase(name, coding)) {
+      return hasNonzeroQuality(parameters);
+    } else if (name == "*") {
+      wildcard = hasNonzeroQuality(parameters);
+    }
+    start = end + 1;
+  }
+  return wildcard.value_or(false);
+}
+
+
+
+std::string_view
+removeWeakPrefix(std::string_view etag) {
+  return etag.substr(0, 2) == "W/" ? etag.substr(2) : etag;
+}
+
+
+}
+
+
+bool
+networking::matchesETag(std::string_view ifNoneMatch, std::string_view etag) {
+  if (trim(ifNoneMatch) == "*") {
+    return true;
+  }
+  etag = removeWeakPrefix(etag);
+
+  // Entity tags are quoted and may themselves contain commas, so the list is
+  // split on the quotes rather than on the commas.
+  std::size_t position = 0;
+  while (true) {
+    position = ifNoneMatch.find_first_not_of(" \t,", position);
+    if (position == std::string_view::npos) {
+      return false;
+    }
+    auto rest = removeWeakPrefix(ifNoneMatch.substr(position));
+    if (rest.empty() || rest.front() != '"') {
+      // Malformed, so nothing after this point can be trusted.
+      return false;
+    }
+    auto closing = rest.find('"', 1);
+    if (closing == std::string_view::npos) {
+      return false;
+    }
+    if (rest.substr(0, closing + 1) == etag) {
+      return true;
+    }
+    position = ifNoneMatch.size() - rest.size() + closing + 1;
+  }
+}
+
+
+std::pair<const AssetVariant*, std::string_view>
+Asset::selectVariant(std::string_view acceptEncoding) const {
+  std::pair<const AssetVariant*, std::string_view> selected{&identity, ""};
+  auto consider = [&] (const AssetVariant& variant, std::string_view coding) {
+    if (variant.body && accepts(acceptEncoding, coding)
+        && (!selected.first->body
+            || variant.body->size() < selected.first->body->size())) {
+      selected = {&variant, coding};
+    }
+  };
+  consider(gzip, "gzip");
+  consider(brotli, "br");
+  return selected;
+}
+
+
+AssetCache::AssetCache(std::string indexHTML, std::string_view directory)
+  : index{"text/html", makeVariant(std::move(indexHTML)), {}, {}} {
+  if (directory.empty()) {
+    return;
+  }
+
+  fs::path root{directory};
+  for (auto& entry : fs::recursive_directory_iterator{root}) {
+    auto& path = entry.path();
+    auto extension = path.extension();
+    if (!entry.is_regular_file() || extension == ".gz" || extension == ".br") {
+      continue;
+    }
+
+    Asset asset{getContentType(path), makeVariant(readFile(path)), {}, {}};
+    if (auto gzipPath = fs::path{path} += ".gz"; fs::is_regular_file(gzipPath)) {
+      asset.gzip = makeVariant(readFile(gzipPath));
+    }
+    if (auto brotliPath = fs::path{path} += ".br"; fs::is_regular_file(brotliPath)) {
+      asset.brotli = makeVariant(readFile(brotliPath));
+    }
+
+    auto urlPath = "/" + fs::relative(path, root).generic_string();
+    assets.emplace(std::move(urlPath), std::move(asset));
+  }
+}
+
+
+const Asset*
+AssetCache::find(std::string_view path) const {
+  auto found = assets.find(std::string{path});
+  return assets.end() == found ? nullptr : &found->second;
+}
+
@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_ASSET_CACHE_H
+#define NETWORKING_ASSET_CACHE_H
+
+#include "Server.h"
+
+#include <boost/beast/http.hpp>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+
+namespace networking {
+
+
+/**
+ *  A beast HTTP body that refers to a SharedText instead of owning a copy of
+ *  its contents. Any number of responses can share the same body buffer.
+ */
+struct SharedTextBody {
+  using value_type = SharedText;
+
+  static std::uint64_t
+  size(const value_type& body) noexcept {
+    return body ? body->size() : 0;
+  }
+
+  class writer {
+  public:
+    using const_buffers_type = boost::asio::const_buffer;
+
+    template <bool isRequest, class Fields>
+    writer(const boost::beast::http::header<isRequest, Fields>&,
+           const value_type& body)
+      : body{body}
+      { }
+
+    void init(boost::beast::error_code& ec) { ec = {}; }
+
+    boost::optional<std::pair<const_buffers_type, bool>>
+    get(boost::beast::error_code& ec) {
+      ec = {};
+      if (!body) {
+        return boost::none;
+      }
+      return {{const_buffers_type{body->data(), body->size()}, false}};
+    }
+
+  private:
+    const value_type& body;
+  };
+};
+
+
+/**
+ *  One encoding of a static asset together with its entity tag.
+ */
+struct AssetVariant {
+  SharedText body;
+  std::string etag;
+};
+
+
+/**
+ *  Whether an If-None-Match header matches the given entity tag. The header
+ *  is either `*` or a comma separated list of entity tags, and comparison is
+ *  weak, so a `W/` prefix on either side is ignored.
+ */
+[[nodiscard]] bool
+matchesETag(std::string_view ifNoneMatch, std::string_view etag);
+
+
+/**
+ *  A file served over HTTP. Precompressed variants are optional and are
+ *  taken from sibling files with `.gz` and `.br` extensions.
+ */
+struct Asset {
+  std::string contentType;
+  AssetVariant identity;
+  AssetVariant gzip;
+  AssetVariant brotli;
+
+  /**
+   *  Return the smallest available variant acceptable to a client that sent
+   *  the given Accept-Encoding header along with the name of its encoding,
+   *  which is empty for the identity encoding.
+   */
+  [[nodiscard]] std::pair<const AssetVariant*, std::string_view>
+  selectVariant(std::string_view acceptEncoding) const;
+};
+
+
+/**
+ *  An immutable set of static assets loaded once at startup. Lookups are
+ *  safe from any number of threads because nothing changes after loading.
+ */
+class AssetCache {
+public:
+  /**
+   *  Build a cache that serves the given HTML for the index and, when a
+   *  directory is given, every file beneath it at its relative URL path.
+   *  Throws std::filesystem::filesystem_error if the directory cannot be read.
+   */
+  AssetCache(std::string indexHTML, std::string_view directory);
+
+  /** The page served for `/` and any path ending in `/index.html`. */
+  [[nodiscard]] const Asset& getIndex() const noexcept { return index; }
+
+  /** Return the asset at the given URL path or nullptr if there is none. */
+  [[nodiscard]] const Asset* find(std::string_view path) const;
+
+private:
+  Asset index;
+  std::unordered_map<std::string, Asset> assets;
+};
+
+
+}
+
+
+#endif
+
@@ -7,15 +7,20 @@
 
 
 #include "Client.h"
+#include "Deflate.h"
+#include "Session.h"
 
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 
 
+#include <algorithm>
 #include <deque>
-#include <sstream>
+#include <optional>
 
+using namespace std::string_literals;
 using networking::Client;
+using networking::ClientContext;
 
 
 /////////////////////////////////////////////////////////////////////////////
@@ -25,35 +30,73 @@ using networking::Client;
 namespace networking {
 
 
+class ClientContext::ContextImpl {
+public:
+  boost::asio::io_context ioContext{1};
+};
+
+
 class Client::ClientImpl {
 public:
-  ClientImpl(std::string_view address, std::string_view port)
+  ClientImpl(std::unique_ptr<boost::asio::io_context> ownedContext,
+             boost::asio::io_context& ioService,
+             std::string_view address,
+             std::string_view port,
+             const ClientOptions& options)
     : isClosed{false},
       hostAddress{address.data(), address.size()},
-      ioService{},
-      websocket{ioService} {
-    boost::asio::ip::tcp::resolver resolver{ioService};
-    connect(resolver.resolve(address, port));
+      port{port.data(), port.size()},
+      options{options},
+      ownedContext{std::move(ownedContext)},
+      ioService{ioService} {
+    open();
   }
 
   void disconnect();
 
+  void open();
+
   void connect(boost::asio::ip::tcp::resolver::iterator endpoint);
 
   void handshake();
 
   void readMessage();
 
+  void writePending();
+
   void reportError(std::string_view message);
 
+  struct Outgoing {
+    std::string text;
+    MessageType type;
+  };
+
   bool isClosed;
+  bool isConnected = false;
+  bool isWriting = false;
   std::string hostAddress;
-  boost::asio::io_service ioService;
-  boost::beast::websocket::stream<boost::asio::ip::tcp::socket> websocket;
-  boost::beast::multi_buffer readBuffer;
-  std::ostringstream incomingMessage;
-  std::deque<std::string> writeBuffer;
-  
+  std::string port;
+  ClientOptions options;
+  // Null when the Client shares the I/O context of a ClientContext.
+  std::unique_ptr<boost::asio::io_context> ownedContext;
+  boost::asio::io_context& ioService;
+  // Replaced on every reconnect. Handlers of a replaced websocket see a stale
+  // generation and do nothing.
+  std::optional<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>> websocket;
+  uint64_t generation = 0;
+  boost::beast::websocket::response_type handshakeResponse;
+  boost::beast::flat_buffer readBuffer;
+
+  // Resumption state. The token identifies the session on the Server, and
+  // the count of received messages tells it where to resume.
+  std::string sessionToken;
+  uint64_t receivedCount = 0;
+  bool resumed = false;
+
+  std::vector<ReceivedMessage> incoming;
+  // Storage from previously received messages that is reused for new ones.
+  std::vector<std::string> spareTexts;
+  std::deque<Outgoing> writeBuffer;
 };
 
 
@@ -63,17 +106,40 @@ public:
 void
 Client::ClientImpl::disconnect() {
   isClosed = true;
-  websocket.async_close(boost::beast::websocket::close_code::normal,
+  isConnected = false;
+  websocket->async_close(boost::beast::websocket::close_code::normal,
     [] (auto errorCode) {
       // Swallow errors while closing.
     });
 }
 
 
+void
+Client::ClientImpl::open() {
+  ++generation;
+  isClosed = false;
+  isConnected = false;
+  isWriting = false;
+  readBuffer.clear();
+  websocket.emplace(ioService);
+  websocket->set_option(makeDeflateOptions(options.compression, false));
+  // A context that ran out of work after the last connection closed stays
+  // stopped until it is restarted.
+  if (ioService.stopped()) {
+    ioService.restart();
+  }
+  boost::asio::ip::tcp::resolver resolver{ioService};
+  connect(resolver.resolve(hostAddress, port));
+}
+
+
 void
 Client::ClientImpl::connect(boost::asio::ip::tcp::resolver::iterator endpoint) {
-  boost::asio::async_connect(websocket.next_layer(), endpoint,
-    [this] (auto errorCode, auto) {
+  boost::asio::async_connect(websocket->next_layer(), endpoint,
+    [this, current = generation] (auto errorCode, auto) {
+      if (current != generation) {
+        return;
+      }
       if (!errorCode) {
         this->handshake();
       } else {
@@ -85,10 +151,29 @@ Client::ClientImpl::connect(boost::asio::ip::tcp::resolver::iterator endpoint) {
 
 void
 Client::ClientImpl::handshake() {
-  websocket.async_handshake(hostAddress, "/",
-    [this] (auto errorCode) {
+  std::string target = "/";
+  if (!sessionToken.empty()) {
+    target += "?"s + SESSION_PARAMETER + "=" + sessionToken
+            + "&" + RECEIVED_PARAMETER + "=" + std::to_string(receivedCount);
+  }
+  websocket->async_handshake(handshakeResponse, hostAddress, target,
+    [this, current = generation] (auto errorCode) {
+      if (current != generation) {
+        return;
+      }
       if (!errorCode) {
+        // A Server that resumed the session echoes the same token.
+        auto token = handshakeResponse[SESSION_TOKEN_HEADER];
+        resumed = !sessionToken.empty() && token == sessionToken;
+        if (!resumed) {
+          receivedCount = 0;
+        }
+        sessionToken.assign(token.data(), token.size());
+        isConnected = true;
         this->readMessage();
+        if (!writeBuffer.empty()) {
+          writePending();
+        }
       } else {
         reportError("Unable to handshake.");
       }
@@ -98,12 +183,24 @@ Client::ClientImpl::handshake() {
 
 void
 Client::ClientImpl::readMessage() {
-  websocket.async_read(readBuffer,
-    [this] (auto errorCode, std::size_t size) {
+  websocket->async_read(readBuffer,
+    [this, current = generation] (auto errorCode, std::size_t size) {
+      if (current != generation) {
+        return;
+      }
       if (!errorCode) {
+        ++receivedCount;
         if (size > 0) {
-          auto message = boost::beast::buffers_to_string(readBuffer.data());
-          incomingMessage.write(message.c_str(), message.size());
+          std::string text;
+          if (!spareTexts.empty()) {
+            text = std::move(spareTexts.back());
+            spareTexts.pop_back();
+          }
+          auto data = readBuffer.cdata();
+          text.assign(static_cast<const char*>(data.data()), data.size());
+          auto type = websocket->got_binary() ? MessageType::BINARY
+                                              : MessageType::TEXT;
+          incoming.push_back({std::move(text), type});
           readBuffer.consume(readBuffer.size());
           this->readMessage();
         }
@@ -115,6 +212,32 @@ Client::ClientImpl::readMessage() {
 }
 
 
+void
+Client::ClientImpl::writePending() {
+  // Beast permits only one write at a time, and the message type applies to
+  // the next write, so writes are chained through their completion handlers.
+  auto& [text, type] = writeBuffer.front();
+  isWriting = true;
+  websocket->binary(type == MessageType::BINARY);
+  websocket->async_write(boost::asio::buffer(text),
+    [this, current = generation] (auto errorCode, std::size_t /*size*/) {
+      if (current != generation) {
+        return;
+      }
+      isWriting = false;
+      if (!errorCode) {
+        writeBuffer.pop_front();
+        if (!writeBuffer.empty()) {
+          writePending();
+        }
+      } else {
+        reportError("Unable to write.");
+        disconnect();
+      }
+    });
+}
+
+
 void
 Client::ClientImpl::reportError(std::string_view /*message*/) {
   // Swallow errors....
@@ -126,8 +249,45 @@ Client::ClientImpl::reportError(std::string_view /*message*/) {
 /////////////////////////////////////////////////////////////////////////////
 
 
-Client::Client(std::string_view address, std::string_view port)
-  : impl{std::make_unique<ClientImpl>(address, port)}
+ClientContext::ClientContext()
+  : impl{std::make_unique<ContextImpl>()}
+    { }
+
+
+ClientContext::~ClientContext() = default;
+
+
+void
+ClientContext::update() {
+  impl->ioContext.poll();
+}
+
+
+void
+ClientContext::updateFor(std::chrono::microseconds timeout) {
+  auto& ioContext = impl->ioContext;
+  ioContext.run_for(timeout);
+  // run_for() leaves the context stopped once it runs out of work.
+  ioContext.restart();
+}
+
+
+Client::Client(std::string_view address,
+               std::string_view port,
+               ClientOptions options) {
+  auto ownedContext = std::make_unique<boost::asio::io_context>(1);
+  auto& ioContext = *ownedContext;
+  impl = std::make_unique<ClientImpl>(std::move(ownedContext), ioContext,
+                                      address, port, options);
+}
+
+
+Client::Client(ClientContext& context,
+               std::string_view address,
+               std::string_view port,
+               ClientOptions options)
+  : impl{std::make_unique<ClientImpl>(nullptr, context.impl->ioContext,
+                                      address, port, options)}
     { }
 
 
@@ -142,29 +302,76 @@ Client::update() {
 
 std::string
 Client::receive() {
-  auto result = impl->incomingMessage.str();
-  impl->incomingMessage.str(std::string{});
-  impl->incomingMessage.clear();
+  std::string result;
+  auto& incoming = impl->incoming;
+  for (auto& message : incoming) {
+    if (message.type == MessageType::TEXT) {
+      result += message.text;
+    }
+  }
+  auto isText = [] (auto& message) { return message.type == MessageType::TEXT; };
+  incoming.erase(std::remove_if(incoming.begin(), incoming.end(), isText),
+                 incoming.end());
+  return result;
+}
+
+
+std::deque<std::string>
+Client::receiveBinary() {
+  std::deque<std::string> result;
+  auto& incoming = impl->incoming;
+  for (auto& message : incoming) {
+    if (message.type == MessageType::BINARY) {
+      result.push_back(std::move(message.text));
+    }
+  }
+  auto isBinary = [] (auto& message) { return message.type == MessageType::BINARY; };
+  incoming.erase(std::remove_if(incoming.begin(), incoming.end(), isBinary),
+                 incoming.end());
   return result;
 }
 
 
 void
-Client::send(std::string message) {
+Client::receive(std::vector<ReceivedMessage>& messages) {
+  // Bound what is retained so that a burst of large messages does not pin
+  // that memory for the lifetime of the Client.
+  constexpr std::size_t MAX_SPARE_TEXTS = 1024;
+  constexpr std::size_t MAX_SPARE_CAPACITY = 64 * 1024;
+  for (auto& message : messages) {
+    if (impl->spareTexts.size() < MAX_SPARE_TEXTS
+        && message.text.capacity() <= MAX_SPARE_CAPACITY) {
+      impl->spareTexts.push_back(std::move(message.text));
+    }
+  }
+  messages.clear();
+  std::swap(messages, impl->incoming);
+}
+
+
+void
+Client::send(std::string message, MessageType type) {
   if (message.empty()) {
     return;
   }
 
-  impl->writeBuffer.emplace_back(std::move(message));
-  impl->websocket.async_write(boost::asio::buffer(impl->writeBuffer.back()),
-    [this] (auto errorCode, std::size_t /*size*/) {
-      if (!errorCode) {
-        impl->writeBuffer.pop_front();
-      } else {
-        impl->reportError("Unable to write.");
-        impl->disconnect();
-      }
-    });
+  impl->writeBuffer.push_back({std::move(message), type});
+  // Messages sent before the handshake completes are written once it does.
+  if (impl->isConnected && !impl->isWriting) {
+    impl->writePending();
+  }
+}
+
+
+void
+Client::reconnect() {
+  impl->open();
+}
+
+
+bool
+Client::wasResumed() const noexcept {
+  return impl->resumed;
 }
 
 
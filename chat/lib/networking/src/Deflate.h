@@ -0,0 +1,41 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_DEFLATE_H
+#define NETWORKING_DEFLATE_H
+
+#include "Compression.h"
+
+#include <boost/beast/websocket/option.hpp>
+
+
+namespace networking {
+
+
+/**
+ *  Translate CompressionOptions into Beast's permessage-deflate settings for
+ *  either the server or the client role.
+ */
+inline boost::beast::websocket::permessage_deflate
+makeDeflateOptions(const CompressionOptions& options, bool isServer) {
+  boost::beast::websocket::permessage_deflate deflate;
+  deflate.server_enable = isServer && options.enabled;
+  deflate.client_enable = !isServer && options.enabled;
+  deflate.server_max_window_bits = options.windowBits;
+  deflate.client_max_window_bits = options.windowBits;
+  deflate.compLevel = options.level;
+  deflate.memLevel = options.memoryLevel;
+  return deflate;
+}
+
+
+}
+
+
+#endif
+
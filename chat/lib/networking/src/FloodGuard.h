@@ -0,0 +1,89 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_FLOOD_GUARD_H
+#define NETWORKING_FLOOD_GUARD_H
+
+#include "Server.h"
+#include "TokenBucket.h"
+
+#include <algorithm>
+#include <cstddef>
+
+
+namespace networking {
+
+
+/**
+ *  @class FloodGuard
+ *
+ *  @brief Applies RateLimits and a FloodPolicy to the messages read from a
+ *  single Connection.
+ *
+ *  The current time is passed in rather than read, so that the policies can
+ *  be exercised without waiting.
+ */
+class FloodGuard {
+public:
+  using Clock = TokenBucket::Clock;
+
+  enum class Verdict {
+    /** Deliver the message. */
+    ACCEPT,
+    /** Discard the message. */
+    REJECT,
+    /** Discard the message and disconnect the Connection. */
+    DISCONNECT,
+  };
+
+  FloodGuard() = default;
+
+  FloodGuard(RateLimits limits, FloodPolicy policy, Clock::time_point now)
+    : policy{policy},
+      messageBucket{limits.messagesPerSecond,
+                    static_cast<double>(limits.burstMessages),
+                    now},
+      byteBucket{limits.bytesPerSecond,
+                 static_cast<double>(limits.burstBytes),
+                 now}
+      { }
+
+  /** Decide what to do with a message of `size` bytes read at `now`. */
+  [[nodiscard]] Verdict
+  admit(std::size_t size, Clock::time_point now) noexcept {
+    messageBucket.refill(now);
+    byteBucket.refill(now);
+
+    if (policy == FloodPolicy::THROTTLE
+        || (messageBucket.canTake(1) && byteBucket.canTake(size))) {
+      // Under THROTTLE the buckets may go into debt, which pauses reading.
+      messageBucket.take(1);
+      byteBucket.take(size);
+      return Verdict::ACCEPT;
+    }
+    return policy == FloodPolicy::DISCONNECT ? Verdict::DISCONNECT : Verdict::REJECT;
+  }
+
+  /** How long reading should pause before the Connection is within limits. */
+  [[nodiscard]] Clock::duration
+  getPause() const noexcept {
+    return std::max(messageBucket.getDebtDuration(),
+                    byteBucket.getDebtDuration());
+  }
+
+private:
+  FloodPolicy policy = FloodPolicy::DROP;
+  TokenBucket messageBucket;
+  TokenBucket byteBucket;
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,97 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "Metrics.h"
+
+#include <cmath>
+#include <sstream>
+
+using networking::LatencyHistogram;
+using networking::ServerMetrics;
+
+
+std::chrono::microseconds
+LatencyHistogram::percentile(double fraction) const {
+  if (count == 0) {
+    return std::chrono::microseconds{0};
+  }
+  auto rank = static_cast<uint64_t>(std::ceil(fraction * count));
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (rank <= seen) {
+      return std::chrono::microseconds{uint64_t{1} << i};
+    }
+  }
+  return std::chrono::microseconds{uint64_t{1} << (buckets.size() - 1)};
+}
+
+
+namespace {
+
+
+void
+writeCounter(std::ostream& out, const char* name, const char* type,
+             uint64_t value) {
+  out << "# TYPE networking_" << name << " " << type << "\n"
+      << "networking_" << name << " " << value << "\n";
+}
+
+
+void
+writeHistogram(std::ostream& out, const char* name,
+               const LatencyHistogram& histogram) {
+  out << "# TYPE networking_" << name << "_seconds histogram\n";
+  uint64_t cumulative = 0;
+  for (std::size_t i = 0; i + 1 < histogram.buckets.size(); ++i) {
+    cumulative += histogram.buckets[i];
+    out << "networking_" << name << "_seconds_bucket{le=\""
+        << static_cast<double>(uint64_t{1} << i) / 1e6 << "\"} "
+        << cumulative << "\n";
+  }
+  out << "networking_" << name << "_seconds_bucket{le=\"+Inf\"} "
+      << histogram.count << "\n"
+      << "networking_" << name << "_seconds_sum "
+      << static_cast<double>(histogram.totalMicroseconds) / 1e6 << "\n"
+      << "networking_" << name << "_seconds_count " << histogram.count << "\n";
+}
+
+
+}
+
+
+std::string
+networking::formatMetrics(const ServerMetrics& metrics) {
+  std::ostringstream out;
+  writeCounter(out, "http_requests_total", "counter", metrics.httpRequests);
+  writeCounter(out, "connections_opened_total", "counter", metrics.connectionsOpened);
+  writeCounter(out, "connections_closed_total", "counter", metrics.connectionsClosed);
+  writeCounter(out, "connections_active", "gauge", metrics.connectionsActive);
+  writeCounter(out, "connections_timed_out_total", "counter", metrics.connectionsTimedOut);
+  writeCounter(out, "sessions_resumed_total", "counter", metrics.sessionsResumed);
+  writeCounter(out, "messages_in_total", "counter", metrics.messagesIn);
+  writeCounter(out, "messages_out_total", "counter", metrics.messagesOut);
+  writeCounter(out, "bytes_in_total", "counter", metrics.bytesIn);
+  writeCounter(out, "bytes_out_total", "counter", metrics.bytesOut);
+  writeCounter(out, "wire_bytes_in_total", "counter", metrics.wireBytesIn);
+  writeCounter(out, "wire_bytes_out_total", "counter", metrics.wireBytesOut);
+  out << "# TYPE networking_compression_ratio gauge\n"
+      << "networking_compression_ratio " << metrics.compressionRatio() << "\n";
+  writeCounter(out, "messages_dropped_total", "counter", metrics.messagesDropped);
+  writeCounter(out, "messages_rejected_total", "counter", metrics.messagesRejected);
+  writeCounter(out, "reads_throttled_total", "counter", metrics.readsThrottled);
+  writeCounter(out, "errors_total", "counter", metrics.errors);
+  writeCounter(out, "queued_messages", "gauge", metrics.queuedMessages);
+  writeCounter(out, "queued_bytes", "gauge", metrics.queuedBytes);
+  writeHistogram(out, "accept_latency", metrics.accept);
+  writeHistogram(out, "read_latency", metrics.read);
+  writeHistogram(out, "write_latency", metrics.write);
+  writeHistogram(out, "update_latency", metrics.update);
+  return out.str();
+}
+
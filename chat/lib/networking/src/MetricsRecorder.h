@@ -0,0 +1,175 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_METRICS_RECORDER_H
+#define NETWORKING_METRICS_RECORDER_H
+
+#include "Metrics.h"
+
+#include <boost/beast/core/rate_policy.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+
+namespace networking {
+
+
+/**
+ *  A LatencyHistogram that can be recorded into concurrently without locks.
+ */
+class AtomicHistogram {
+public:
+  void
+  record(std::chrono::steady_clock::duration elapsed) noexcept {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    auto value = static_cast<uint64_t>(std::max<decltype(micros)>(0, micros));
+    buckets[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    totalMicroseconds.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] LatencyHistogram
+  snapshot() const noexcept {
+    LatencyHistogram result;
+    for (std::size_t i = 0; i < buckets.size(); ++i) {
+      result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    result.count = count.load(std::memory_order_relaxed);
+    result.totalMicroseconds = totalMicroseconds.load(std::memory_order_relaxed);
+    return result;
+  }
+
+private:
+  // The bucket of a value is the number of bits needed to represent it.
+  static std::size_t
+  bucketFor(uint64_t micros) noexcept {
+    std::size_t width = 0;
+#if defined(__GNUC__)
+    width = micros == 0 ? 0 : 64 - __builtin_clzll(micros);
+#else
+    for (; micros != 0; micros >>= 1) {
+      ++width;
+    }
+#endif
+    return std::min(width, LatencyHistogram::BUCKET_COUNT - 1);
+  }
+
+  std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT> buckets{};
+  std::atomic<uint64_t> count = 0;
+  std::atomic<uint64_t> totalMicroseconds = 0;
+};
+
+
+/**
+ *  The hot path counters of a Server. Everything is updated with relaxed
+ *  atomics, so recording is cheap from any thread, and a snapshot is only
+ *  approximately consistent across counters.
+ */
+struct MetricsRecorder {
+  using Counter = std::atomic<uint64_t>;
+
+  static void
+  increment(Counter& counter, uint64_t amount = 1) noexcept {
+    counter.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  Counter httpRequests = 0;
+  Counter connectionsOpened = 0;
+  Counter connectionsClosed = 0;
+  Counter connectionsTimedOut = 0;
+  Counter sessionsResumed = 0;
+  Counter messagesIn = 0;
+  Counter messagesOut = 0;
+  Counter bytesIn = 0;
+  Counter bytesOut = 0;
+  Counter wireBytesIn = 0;
+  Counter wireBytesOut = 0;
+  Counter messagesDropped = 0;
+  Counter messagesRejected = 0;
+  Counter readsThrottled = 0;
+  Counter errors = 0;
+
+  AtomicHistogram accept;
+  AtomicHistogram read;
+  AtomicHistogram write;
+  AtomicHistogram update;
+
+  [[nodiscard]] ServerMetrics
+  snapshot() const noexcept {
+    auto load = [] (const Counter& counter) {
+      return counter.load(std::memory_order_relaxed);
+    };
+    ServerMetrics result;
+    result.httpRequests = load(httpRequests);
+    result.connectionsOpened = load(connectionsOpened);
+    result.connectionsClosed = load(connectionsClosed);
+    result.connectionsActive =
+      result.connectionsOpened - std::min(result.connectionsOpened,
+                                          result.connectionsClosed);
+    result.connectionsTimedOut = load(connectionsTimedOut);
+    result.sessionsResumed = load(sessionsResumed);
+    result.messagesIn = load(messagesIn);
+    result.messagesOut = load(messagesOut);
+    result.bytesIn = load(bytesIn);
+    result.bytesOut = load(bytesOut);
+    result.wireBytesIn = load(wireBytesIn);
+    result.wireBytesOut = load(wireBytesOut);
+    result.messagesDropped = load(messagesDropped);
+    result.messagesRejected = load(messagesRejected);
+    result.readsThrottled = load(readsThrottled);
+    result.errors = load(errors);
+    result.accept = accept.snapshot();
+    result.read = read.snapshot();
+    result.write = write.snapshot();
+    result.update = update.snapshot();
+    return result;
+  }
+};
+
+
+/**
+ *  A Beast RatePolicy that never limits a stream but counts the bytes that
+ *  it transfers. These are the bytes actually on the wire, after websocket
+ *  framing and compression.
+ */
+class WireCounter {
+public:
+  explicit WireCounter(MetricsRecorder& metrics)
+    : metrics{&metrics}
+    { }
+
+private:
+  friend class boost::beast::rate_policy_access;
+
+  static constexpr auto UNLIMITED = std::numeric_limits<std::size_t>::max();
+
+  std::size_t available_read_bytes() const noexcept  { return UNLIMITED; }
+  std::size_t available_write_bytes() const noexcept { return UNLIMITED; }
+  void on_timer() const noexcept { }
+
+  void
+  transfer_read_bytes(std::size_t bytes) const noexcept {
+    MetricsRecorder::increment(metrics->wireBytesIn, bytes);
+  }
+
+  void
+  transfer_write_bytes(std::size_t bytes) const noexcept {
+    MetricsRecorder::increment(metrics->wireBytesOut, bytes);
+  }
+
+  MetricsRecorder* metrics;
+};
+
+
+}
+
+
+#endif
+
@@ -0,0 +1,89 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_OVERFLOW_H
+#define NETWORKING_OVERFLOW_H
+
+#include "Server.h"
+#include "Session.h"
+
+#include <cstddef>
+#include <deque>
+
+
+namespace networking {
+
+
+/**
+ *  What to do with an outgoing queue that has just grown. Either the
+ *  Connection is disconnected, or the queued messages in [dropBegin, dropEnd)
+ *  are discarded, which may be none of them.
+ */
+struct OverflowAction {
+  bool disconnect = false;
+  std::size_t dropBegin = 0;
+  std::size_t dropEnd = 0;
+};
+
+
+/**
+ *  Apply the QueueLimits and OverflowPolicy to a queue whose first `inFlight`
+ *  messages are being written and whose total size is `depth`. Messages that
+ *  are part of an in progress write cannot be discarded, and the newest
+ *  message is always kept.
+ */
+[[nodiscard]] inline OverflowAction
+planOverflow(const std::deque<Outgoing>& queue,
+             std::size_t inFlight,
+             QueueDepth depth,
+             QueueLimits limits,
+             OverflowPolicy policy) {
+  auto [messages, bytes] = depth;
+  auto exceeds = [] (std::size_t amount, std::size_t limit) {
+    return 0 < limit && limit < amount;
+  };
+  if (queue.empty()
+      || (!exceeds(messages, limits.highWaterMessages)
+          && !exceeds(bytes, limits.highWaterBytes))) {
+    return {};
+  }
+
+  auto droppableEnd = queue.size() - 1;
+  switch (policy) {
+    case OverflowPolicy::DISCONNECT:
+      return {true, 0, 0};
+
+    case OverflowPolicy::KEEP_LATEST:
+      if (inFlight < droppableEnd) {
+        return {false, inFlight, droppableEnd};
+      }
+      return {};
+
+    case OverflowPolicy::DROP_OLDEST: {
+      auto lowMessages = limits.lowWaterMessages
+        ? limits.lowWaterMessages : limits.highWaterMessages;
+      auto lowBytes = limits.lowWaterBytes
+        ? limits.lowWaterBytes : limits.highWaterBytes;
+      auto last = inFlight;
+      while (last < droppableEnd
+          && (exceeds(messages, lowMessages) || exceeds(bytes, lowBytes))) {
+        messages -= 1;
+        bytes -= queue[last].text->size();
+        ++last;
+      }
+      return {false, inFlight, last};
+    }
+  }
+  return {};
+}
+
+
+}
+
+
+#endif
@@ -0,0 +1,175 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "RoomManager.h"
+
+#include <algorithm>
+#include <thread>
+
+using networking::Connection;
+using networking::RoomId;
+using networking::RoomManager;
+
+
+namespace {
+
+
+// Spread nearby ids (e.g. sequentially numbered games) across shards.
+std::size_t
+mix(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdull;
+  value ^= value >> 33;
+  return static_cast<std::size_t>(value);
+}
+
+
+std::size_t
+resolveShardCount(std::size_t requested) {
+  if (0 < requested) {
+    return requested;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+}
+
+
+RoomManager::RoomManager(std::size_t shardCount)
+  : roomShards(resolveShardCount(shardCount)),
+    connectionShards(resolveShardCount(shardCount))
+    { }
+
+
+std::size_t
+RoomManager::getShard(RoomId room) const noexcept {
+  return mix(room) % roomShards.size();
+}
+
+
+RoomManager::ConnectionShard&
+RoomManager::getConnectionShard(Connection connection) const {
+  return connectionShards[mix(connection.id) % connectionShards.size()];
+}
+
+
+void
+RoomManager::join(Connection connection, RoomId room) {
+  auto& shard = getConnectionShard(connection);
+  std::lock_guard lock{shard.lock};
+  auto [found, inserted] = shard.rooms.try_emplace(connection, room);
+  if (!inserted) {
+    if (found->second == room) {
+      return;
+    }
+    removeMember(connection, found->second);
+    found->second = room;
+  }
+  addMember(connection, room);
+}
+
+
+void
+RoomManager::leave(Connection connection) {
+  auto& shard = getConnectionShard(connection);
+  std::lock_guard lock{shard.lock};
+  auto found = shard.rooms.find(connection);
+  if (shard.rooms.end() == found) {
+    return;
+  }
+  removeMember(connection, found->second);
+  shard.rooms.erase(found);
+}
+
+
+std::optional<RoomId>
+RoomManager::getRoom(Connection connection) const {
+  auto& shard = getConnectionShard(connection);
+  std::lock_guard lock{shard.lock};
+  auto found = shard.rooms.find(connection);
+  if (shard.rooms.end() == found) {
+    return std::nullopt;
+  }
+  return found->second;
+}
+
+
+std::vector<Connection>
+RoomManager::getMembers(RoomId room) const {
+  auto& shard = roomShards[getShard(room)];
+  std::lock_guard lock{shard.lock};
+  auto found = shard.rooms.find(room);
+  if (shard.rooms.end() == found) {
+    return {};
+  }
+  return found->second.members;
+}
+
+
+std::size_t
+RoomManager::getMemberCount(RoomId room) const {
+  auto& shard = roomShards[getShard(room)];
+  std::lock_guard lock{shard.lock};
+  auto found = shard.rooms.find(room);
+  return shard.rooms.end() == found ? 0 : found->second.members.size();
+}
+
+
+void
+RoomManager::broadcast(Server& server,
+                       RoomId room,
+                       SharedText text,
+                       MessageType type) const {
+  auto& shard = roomShards[getShard(room)];
+  std::lock_guard lock{shard.lock};
+  auto found = shard.rooms.find(room);
+  if (shard.rooms.end() != found) {
+    server.broadcast(std::move(text), found->second.members, type);
+  }
+}
+
+
+void
+RoomManager::addMember(Connection connection, RoomId room) {
+  auto& shard = roomShards[getShard(room)];
+  std::lock_guard lock{shard.lock};
+  auto& [members, positions] = shard.rooms[room];
+  positions[connection] = members.size();
+  members.push_back(connection);
+}
+
+
+void
+RoomManager::removeMember(Connection connection, RoomId room) {
+  auto& shard = roomShards[getShard(room)];
+  std::lock_guard lock{shard.lock};
+  auto found = shard.rooms.find(room);
+  if (shard.rooms.end() == found) {
+    return;
+  }
+
+  // Swap the last member into the vacated slot so removal is O(1).
+  auto& [members, positions] = found->second;
+  auto position = positions.find(connection);
+  if (positions.end() == position) {
+    return;
+  }
+  auto index = position->second;
+  positions.erase(position);
+  if (index + 1 != members.size()) {
+    members[index] = members.back();
+    positions[members[index]] = index;
+  }
+  members.pop_back();
+
+  if (members.empty()) {
+    shard.rooms.erase(found);
+  }
+}
+
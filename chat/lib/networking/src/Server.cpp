@@ -7,12 +7,36 @@
 
 
 #include "Server.h"
+#include "AssetCache.h"
+#include "Deflate.h"
+#include "FloodGuard.h"
+#include "MetricsRecorder.h"
+#include "Overflow.h"
+#include "Session.h"
+#include "SlotMap.h"
 
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
 using namespace std::string_literals;
+using Clock = std::chrono::steady_clock;
 using networking::Message;
+using networking::MessageType;
+using networking::QueueDepth;
+using networking::Session;
+using networking::ServerMetrics;
+using networking::MetricsRecorder;
+using networking::WireCounter;
+using networking::Asset;
+using networking::matchesETag;
+using networking::SharedTextBody;
 using networking::Server;
 using networking::ServerImpl;
 using networking::ServerImplDeleter;
@@ -33,30 +57,124 @@ class Channel;
 class ServerImpl {
 public:
 
-  ServerImpl(Server& server, unsigned short port, std::string httpMessage)
+  ServerImpl(Server& server,
+             unsigned short port,
+             std::string httpMessage,
+             ServerOptions options)
    : server{server},
+     options{options},
      endpoint{boost::asio::ip::tcp::v4(), port},
-     ioContext{},
-     acceptor{ioContext, endpoint},
-     httpMessage{std::move(httpMessage)} {
+     ioContext{static_cast<int>(std::max(1u, options.ioThreads))},
+     keepRunning{ioContext.get_executor()},
+     // With several I/O threads the acceptor has its own strand so that
+     // draining can close it while other threads run its handlers.
+     acceptor{options.ioThreads > 1
+                ? boost::asio::any_io_executor{boost::asio::make_strand(ioContext)}
+                : boost::asio::any_io_executor{ioContext.get_executor()},
+              endpoint},
+     assets{std::move(httpMessage), options.assetDirectory},
+     overflowPolicy{options.overflowPolicy} {
     listenForConnections();
+    startWorkers();
   }
 
+  ~ServerImpl();
+
   void listenForConnections();
+  template <typename HTTPSessionPtr>
+  void acceptConnection(HTTPSessionPtr session);
+  void stopAccepting();
+  void startWorkers();
   void registerChannel(Channel& channel);
+  void dropChannel(Connection connection);
+  [[nodiscard]] std::shared_ptr<Session> createSession();
+  [[nodiscard]] std::shared_ptr<Session> findSession(std::string_view token);
+  [[nodiscard]] std::optional<std::deque<Outgoing>>
+  resumeChannel(Channel& channel, Session& session, uint64_t received);
+  void detachSession(std::shared_ptr<Session> session, uint64_t generation);
+  void expireSession(Session& session, uint64_t generation);
+  void endSession(Session& session);
+  void pushIncoming(Connection connection,
+                    boost::asio::const_buffer text,
+                    MessageType type);
+  void recycleIncoming(std::vector<Message>& messages);
+  void recordReceipt();
+  void deliverConnectionEvents();
+  void signalConnectionEvent();
+  void fireTimers();
+  void reportDrained(bool clean);
+  void watchIdle(Connection connection);
   void reportError(std::string_view message);
 
-  using ChannelMap =
-    std::unordered_map<Connection, std::shared_ptr<Channel>, ConnectionHash>;
+  [[nodiscard]] bool
+  isThreaded() const noexcept {
+    return !workers.empty();
+  }
+
+  // A single I/O thread already runs handlers one at a time, so each
+  // connection only needs a strand when there are several.
+  [[nodiscard]] bool
+  usesStrands() const noexcept {
+    return 1 < options.ioThreads;
+  }
+
+  // Connection IDs are keys into this map, so looking up a Channel is an
+  // array access, and IDs of closed Connections never match a new Channel.
+  using ChannelMap = SlotMap<std::shared_ptr<Channel>>;
+
+  // Connects and disconnects that happen on I/O threads are queued and
+  // delivered to the connection handler on the thread that owns the Server.
+  struct ConnectionEvent {
+    Connection connection;
+    bool connected;
+  };
 
   Server& server;
+  const ServerOptions options;
   const boost::asio::ip::tcp::endpoint endpoint;
   boost::asio::io_context ioContext;
+  // Keeps the I/O threads running even once nothing is being accepted.
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> keepRunning;
   boost::asio::ip::tcp::acceptor acceptor;
-  boost::beast::http::string_body::value_type httpMessage;
+  std::atomic<bool> accepting = true;
+  const AssetCache assets;
+  std::atomic<OverflowPolicy> overflowPolicy;
+  MetricsRecorder metrics;
 
+  std::mutex channelLock;
   ChannelMap channels;
-  std::deque<Message> incoming;
+  std::vector<ConnectionEvent> connectionEvents;
+  // Sessions whose Channels dropped, awaiting a retention timer.
+  std::vector<std::pair<std::shared_ptr<Session>, uint64_t>> detachedSessions;
+
+  std::mutex sessionLock;
+  std::unordered_map<std::string_view, std::shared_ptr<Session>> sessions;
+  // Tokens are bearer credentials for resuming a session, so every bit comes
+  // straight from the operating system's CSPRNG rather than a seeded engine.
+  // Guarded by sessionLock.
+  std::random_device tokenSource{"/dev/urandom"};
+
+  std::mutex incomingLock;
+  std::condition_variable incomingReady;
+  std::vector<Message> incoming;
+  // Set when a connection event is queued so that a waiting updateUntil
+  // wakes to deliver it. Guarded by incomingLock rather than channelLock so
+  // that waiting never needs both.
+  bool connectionEventsQueued = false;
+  Clock::time_point oldestIncoming;
+  // Strings from previously received messages whose storage is reused for
+  // new messages, so that steady state receiving does not allocate.
+  std::vector<std::string> spareTexts;
+
+  // Only touched from the thread that owns the Server.
+  TimerWheel timers;
+
+  std::mutex drainLock;
+  std::condition_variable drainProgress;
+  std::size_t drainRemaining = 0;
+  DrainResult drainResult;
+
+  std::vector<std::thread> workers;
 };
 
 
@@ -65,121 +183,640 @@ public:
 /////////////////////////////////////////////////////////////////////////////
 
 
+/**
+ *  A non-owning view of gathered buffers. Composed write operations copy
+ *  their buffer sequence, and copying a view avoids copying the vector.
+ */
+struct BufferRange {
+  using value_type = boost::asio::const_buffer;
+  using const_iterator = const boost::asio::const_buffer*;
+
+  const_iterator first;
+  const_iterator last;
+
+  [[nodiscard]] const_iterator begin() const noexcept { return first; }
+  [[nodiscard]] const_iterator end() const noexcept { return last; }
+};
+
+
+/**
+ *  The part of a connection that the Server shares across threads. The
+ *  websocket itself lives in a BasicChannel, whose executor depends on
+ *  whether handlers may run on more than one thread.
+ */
 class Channel : public std::enable_shared_from_this<Channel> {
 public:
-  Channel(boost::asio::ip::tcp::socket socket, ServerImpl& serverImpl)
-    : disconnected{false},
-      connection{reinterpret_cast<uintptr_t>(this)},
+  virtual ~Channel() = default;
+
+  virtual void start(boost::beast::http::request<boost::beast::http::string_body>& request) = 0;
+  virtual void send(SharedText outgoing, MessageType type) = 0;
+  // Queues a message directly, so it must be called from a handler running
+  // on the Channel's executor, or when the Server has no I/O threads.
+  virtual void sendOnExecutor(SharedText outgoing, MessageType type) = 0;
+  virtual void disconnect() = 0;
+  virtual void setQueueLimits(QueueLimits newLimits) = 0;
+  virtual void setRateLimits(RateLimits newLimits) = 0;
+  virtual void ping() = 0;
+  virtual void drain() = 0;
+  virtual void forceClose() = 0;
+
+  [[nodiscard]] Connection getConnection() const noexcept { return connection; }
+
+  [[nodiscard]] Session* getSession() const noexcept { return session.get(); }
+
+  // The Connection is assigned when the Channel is registered with the
+  // Server, before any messages are read from or written to it.
+  void setConnection(Connection assigned) noexcept { connection = assigned; }
+
+  [[nodiscard]] Clock::time_point
+  getLastActivity() const noexcept {
+    return Clock::time_point{
+      Clock::duration{lastActivity.load(std::memory_order_relaxed)}};
+  }
+
+  [[nodiscard]] Clock::time_point getAcceptTime() const noexcept { return acceptedAt; }
+
+  [[nodiscard]] QueueDepth
+  getQueueDepth() const noexcept {
+    return {queuedMessages.load(std::memory_order_relaxed),
+            queuedBytes.load(std::memory_order_relaxed)};
+  }
+
+protected:
+  Channel(ServerImpl& serverImpl, Clock::time_point acceptedAt)
+    : connection{0},
       serverImpl{serverImpl},
-      streamBuf{},
-      websocket{std::move(socket)},
-      readBuffer{serverImpl.incoming}
+      acceptedAt{acceptedAt},
+      lastActivity{acceptedAt.time_since_epoch().count()}
       { }
 
-  void start(boost::beast::http::request<boost::beast::http::string_body>& request);
-  void send(std::string outgoing);
-  void disconnect();
+  void
+  touch() noexcept {
+    lastActivity.store(Clock::now().time_since_epoch().count(),
+                       std::memory_order_relaxed);
+  }
+
+  Connection connection;
+  ServerImpl &serverImpl;
+  Clock::time_point acceptedAt;
 
-  [[nodiscard]] Connection getConnection() const noexcept { return connection; }
+  // Only set when sessions are enabled. A detached Channel's websocket has
+  // failed, and messages sent to it are parked in or forwarded by the
+  // Session.
+  std::shared_ptr<Session> session;
+
+  // Mirrors of the queue size and activity that may be read from any thread.
+  std::atomic<std::size_t> queuedMessages = 0;
+  std::atomic<std::size_t> queuedBytes = 0;
+  std::atomic<Clock::rep> lastActivity;
+};
+
+
+/**
+ *  A Channel whose handlers all run on the given executor. With more than
+ *  one I/O thread that is a strand of the io_context, and otherwise it is
+ *  the io_context's own executor, which already runs handlers one at a time.
+ *  Using the concrete type rather than any_io_executor keeps the executor
+ *  copies made by every operation from allocating.
+ */
+template <typename Executor>
+class BasicChannel final : public Channel {
+public:
+  using Socket = boost::asio::basic_stream_socket<boost::asio::ip::tcp, Executor>;
+
+  BasicChannel(Socket socket,
+               ServerImpl& serverImpl,
+               Clock::time_point acceptedAt)
+    : Channel{serverImpl, acceptedAt},
+      disconnected{false},
+      streamBuf{},
+      websocket{WireCounter{serverImpl.metrics}, std::move(socket)},
+      limits{serverImpl.options.queueLimits},
+      throttleTimer{websocket.get_executor()} {
+    applyRateLimits(serverImpl.options.rateLimits);
+  }
+
+  void start(boost::beast::http::request<boost::beast::http::string_body>& request) override;
+  void send(SharedText outgoing, MessageType type) override;
+  void sendOnExecutor(SharedText outgoing, MessageType type) override;
+  void disconnect() override;
+  void setQueueLimits(QueueLimits newLimits) override;
+  void setRateLimits(RateLimits newLimits) override;
+  void ping() override;
+  void drain() override;
+  void forceClose() override;
 
 private:
+  void close();
+  void enqueue(Outgoing outgoing);
+  void detach();
+  void handleOverflow();
+  void dropQueued(std::size_t first, std::size_t last);
+  void writePending();
   void readMessage();
   void afterWrite(std::error_code errorCode, std::size_t size);
+  void applyRateLimits(RateLimits newLimits);
+  bool admitIncoming(std::size_t size);
+  void continueReading();
+  void finishDrain(bool clean);
 
+  // All state below is only touched from handlers running on the
+  // websocket's executor.
   bool disconnected;
-  Connection connection;
-  ServerImpl &serverImpl;
+  // Set once the websocket handshake has completed.
+  bool accepted = false;
 
-  boost::beast::flat_buffer streamBuf;
-  boost::beast::websocket::stream<boost::asio::ip::tcp::socket> websocket;
+  // The websocket runs over a basic_stream so that a rate policy can count
+  // the bytes that actually cross the wire.
+  using WireStream =
+    boost::beast::basic_stream<boost::asio::ip::tcp, Executor, WireCounter>;
 
-  std::deque<Message> &readBuffer;
-  std::deque<std::string> writeBuffer;
+  boost::beast::flat_buffer streamBuf;
+  boost::beast::websocket::stream<WireStream> websocket;
+
+  std::deque<Outgoing> writeBuffer;
+  std::vector<boost::asio::const_buffer> gatherBuffers;
+  std::size_t inFlight = 0;
+  Clock::time_point writeStarted;
+  QueueLimits limits;
+  bool pingInFlight = false;
+  bool draining = false;
+  bool drainReported = false;
+  bool detached = false;
+
+  FloodGuard floodGuard;
+  boost::asio::basic_waitable_timer<Clock,
+                                    boost::asio::wait_traits<Clock>,
+                                    Executor> throttleTimer;
 };
 
+
+/** Connections are served on strands only when several threads run handlers. */
+using StrandExecutor = boost::asio::strand<boost::asio::io_context::executor_type>;
+using DirectExecutor = boost::asio::io_context::executor_type;
+
 }
 
+using networking::BasicChannel;
 using networking::Channel;
+using networking::DirectExecutor;
+using networking::StrandExecutor;
 
 
+namespace {
+
+
+std::string_view
+getQueryParameter(std::string_view target, std::string_view name) {
+  auto query = target.find('?');
+  while (query != std::string_view::npos) {
+    auto begin = query + 1;
+    auto end = std::min(target.find('&', begin), target.size());
+    auto parameter = target.substr(begin, end - begin);
+    if (parameter.size() > name.size()
+        && parameter.substr(0, name.size()) == name
+        && parameter[name.size()] == '=') {
+      return parameter.substr(name.size() + 1);
+    }
+    query = end < target.size() ? end : std::string_view::npos;
+  }
+  return {};
+}
+
+
+}
+
+
+template <typename Executor>
 void
-Channel::start(boost::beast::http::request<boost::beast::http::string_body>& request) {
+BasicChannel<Executor>::start(boost::beast::http::request<boost::beast::http::string_body>& request) {
   auto self = shared_from_this();
+  websocket.set_option(makeDeflateOptions(serverImpl.options.compression, true));
+  if (0 < serverImpl.options.maxMessageSize) {
+    websocket.read_message_max(serverImpl.options.maxMessageSize);
+  }
+  // Pongs and other control frames show that a quiet Client is still alive.
+  websocket.control_callback(
+    [this] (auto /*kind*/, auto /*payload*/) { touch(); });
+
+  std::optional<std::deque<Outgoing>> missed;
+  if (serverImpl.options.sessions.enabled) {
+    auto target = std::string_view{request.target().data(), request.target().size()};
+    auto token = getQueryParameter(target, SESSION_PARAMETER);
+    auto received = getQueryParameter(target, RECEIVED_PARAMETER);
+    if (auto found = serverImpl.findSession(token)) {
+      // The Session is taken over before the handshake, so that a Client
+      // whose resume fails is sent a new token rather than its old one.
+      auto count = std::strtoull(std::string{received}.c_str(), nullptr, 10);
+      missed = serverImpl.resumeChannel(*this, *found, count);
+      if (missed) {
+        session = std::move(found);
+      }
+    }
+    if (!session) {
+      session = serverImpl.createSession();
+    }
+    websocket.set_option(boost::beast::websocket::stream_base::decorator(
+      [token = session->getToken()] (boost::beast::websocket::response_type& response) {
+        response.set(SESSION_TOKEN_HEADER, token);
+      }));
+  }
+
+  bool resumed = missed.has_value();
+  if (resumed) {
+    // Queueing the missed messages now keeps them ahead of any that the old
+    // Channel forwards afterward. Nothing is written until the handshake
+    // completes.
+    for (auto& outgoing : *missed) {
+      enqueue(std::move(outgoing));
+    }
+  }
+
   websocket.async_accept(request,
-    [this, self] (std::error_code errorCode) {
-      if (!errorCode) {
+    [this, self, resumed] (std::error_code errorCode) {
+      if (errorCode) {
+        if (resumed) {
+          // The Client may still try again before the Session expires.
+          detach();
+        } else if (session) {
+          serverImpl.endSession(*session);
+        }
+        return;
+      }
+      accepted = true;
+      if (!resumed) {
         serverImpl.registerChannel(*this);
-        self->readMessage();
-      } else {
-        serverImpl.server.disconnect(connection);
+      } else if (!writeBuffer.empty() && inFlight == 0 && !disconnected) {
+        writePending();
       }
+      readMessage();
     });
 }
 
 
+template <typename Executor>
+void
+BasicChannel<Executor>::disconnect() {
+  boost::asio::post(websocket.get_executor(),
+    [this, self = shared_from_this()] { close(); });
+}
+
+
+template <typename Executor>
 void
-Channel::disconnect() {
+BasicChannel<Executor>::close() {
+  // Closing deliberately ends the Session, even if the websocket already
+  // failed and the Session is waiting to be resumed.
+  if (session) {
+    serverImpl.endSession(*session);
+  }
+  if (disconnected) {
+    return;
+  }
   disconnected = true;
-  boost::beast::error_code ec;
-  websocket.close(boost::beast::websocket::close_reason{}, ec);
+  throttleTimer.cancel();
+  websocket.async_close(boost::beast::websocket::close_reason{},
+    [this, self = shared_from_this()] (auto errorCode) {
+      // Errors while closing are otherwise swallowed.
+      if (draining) {
+        finishDrain(!errorCode);
+      }
+    });
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::drain() {
+  boost::asio::post(websocket.get_executor(),
+    [this, self = shared_from_this()] {
+      draining = true;
+      if (disconnected) {
+        finishDrain(false);
+      } else if (writeBuffer.empty()) {
+        close();
+      }
+      // Otherwise afterWrite() closes once the queue has been written.
+    });
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::forceClose() {
+  boost::asio::post(websocket.get_executor(),
+    [this, self = shared_from_this()] {
+      disconnected = true;
+      throttleTimer.cancel();
+      boost::beast::error_code ignored;
+      boost::beast::get_lowest_layer(websocket).socket().close(ignored);
+    });
 }
 
 
+template <typename Executor>
 void
-Channel::send(std::string outgoing) {
-  if (outgoing.empty()) {
+BasicChannel<Executor>::finishDrain(bool clean) {
+  if (drainReported) {
     return;
   }
+  drainReported = true;
+  // A Channel that detached while draining will never be resumed, so its
+  // Session has to end here or it would stay registered forever.
+  if (session) {
+    serverImpl.endSession(*session);
+  }
+  serverImpl.dropChannel(connection);
+  serverImpl.reportDrained(clean);
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::setQueueLimits(QueueLimits newLimits) {
+  boost::asio::post(websocket.get_executor(),
+    [this, self = shared_from_this(), newLimits] {
+      limits = newLimits;
+      handleOverflow();
+    });
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::setRateLimits(RateLimits newLimits) {
+  boost::asio::post(websocket.get_executor(),
+    [this, self = shared_from_this(), newLimits] {
+      applyRateLimits(newLimits);
+    });
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::applyRateLimits(RateLimits newLimits) {
+  floodGuard = FloodGuard{newLimits, serverImpl.options.floodPolicy, Clock::now()};
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::ping() {
+  boost::asio::post(websocket.get_executor(),
+    [this, self = shared_from_this()] {
+      if (disconnected || pingInFlight || !accepted) {
+        return;
+      }
+      pingInFlight = true;
+      websocket.async_ping({},
+        [this, self] (auto /*errorCode*/) { pingInFlight = false; });
+    });
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::send(SharedText outgoing, MessageType type) {
+  if (outgoing->empty()) {
+    return;
+  }
+  if (!serverImpl.isThreaded()) {
+    // Handlers only run inside Server::update() on this same thread.
+    enqueue({std::move(outgoing), type});
+    return;
+  }
+  boost::asio::post(websocket.get_executor(),
+    [this, self = shared_from_this(), outgoing = std::move(outgoing), type] () mutable {
+      enqueue({std::move(outgoing), type});
+    });
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::sendOnExecutor(SharedText outgoing, MessageType type) {
+  if (!outgoing->empty()) {
+    enqueue({std::move(outgoing), type});
+  }
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::enqueue(Outgoing outgoing) {
+  if (detached) {
+    if (auto next = session->parkOrForward(outgoing)) {
+      next->send(std::move(outgoing.text), outgoing.type);
+    }
+    return;
+  }
+  if (disconnected) {
+    return;
+  }
+  queuedMessages.fetch_add(1, std::memory_order_relaxed);
+  queuedBytes.fetch_add(outgoing.text->size(), std::memory_order_relaxed);
   writeBuffer.push_back(std::move(outgoing));
+  handleOverflow();
 
-  if (1 < writeBuffer.size()) {
-    // Note, multiple writes will be chained within asio via `continueSending`,
+  if (0 < inFlight || disconnected || !accepted) {
+    // Note, multiple writes will be chained within asio via `afterWrite`,
     // so that callback should be used instead of directly invoking async_write
-    // again.
+    // again. Messages queued before the handshake wait for it to finish.
+    return;
+  }
+  writePending();
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::handleOverflow() {
+  auto action = planOverflow(writeBuffer, inFlight, getQueueDepth(), limits,
+                             serverImpl.overflowPolicy.load(std::memory_order_relaxed));
+  if (action.disconnect) {
+    serverImpl.dropChannel(connection);
+    close();
+    return;
+  }
+  if (action.dropBegin == action.dropEnd) {
     return;
   }
+  auto sizeBefore = writeBuffer.size();
+  dropQueued(action.dropBegin, action.dropEnd);
+  MetricsRecorder::increment(serverImpl.metrics.messagesDropped,
+                             sizeBefore - writeBuffer.size());
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::dropQueued(std::size_t first, std::size_t last) {
+  std::size_t bytes = 0;
+  for (auto i = first; i < last; ++i) {
+    bytes += writeBuffer[i].text->size();
+  }
+  writeBuffer.erase(writeBuffer.begin() + first, writeBuffer.begin() + last);
+  queuedMessages.fetch_sub(last - first, std::memory_order_relaxed);
+  queuedBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::writePending() {
+  // Gather up to maxWriteBatch queued messages into a single websocket
+  // message. The buffers refer directly to the shared payloads, so batching
+  // costs no copies, and a burst of small messages becomes one frame and one
+  // write instead of many.
+  // Binary payloads are not self delimiting, so they are never coalesced.
+  // A resuming Client counts websocket messages, so those are never
+  // coalesced either.
+  auto type = writeBuffer.front().type;
+  auto batchLimit = type == MessageType::BINARY || session
+    ? 1
+    : std::min(writeBuffer.size(),
+               std::max<std::size_t>(1, serverImpl.options.maxWriteBatch));
+  gatherBuffers.clear();
+  std::size_t batchSize = 0;
+  while (batchSize < batchLimit && writeBuffer[batchSize].type == type) {
+    gatherBuffers.push_back(boost::asio::buffer(*writeBuffer[batchSize].text));
+    ++batchSize;
+  }
+  if (session) {
+    session->recordWritten(writeBuffer.front());
+  }
+  inFlight = batchSize;
+  websocket.binary(type == MessageType::BINARY);
+  writeStarted = Clock::now();
 
-  websocket.async_write(boost::asio::buffer(writeBuffer.front()),
+  websocket.async_write(BufferRange{gatherBuffers.data(),
+                                    gatherBuffers.data() + batchSize},
     [this, self = shared_from_this()] (auto errorCode, std::size_t size) {
       afterWrite(errorCode, size);
     });
 }
 
 
+template <typename Executor>
 void
-Channel::afterWrite(std::error_code errorCode, std::size_t size) {
+BasicChannel<Executor>::afterWrite(std::error_code errorCode, std::size_t size) {
   if (errorCode) {
+    if (session && !disconnected) {
+      detach();
+      return;
+    }
     if (!disconnected) {
-      serverImpl.server.disconnect(connection);
+      serverImpl.dropChannel(connection);
+    }
+    if (draining) {
+      finishDrain(false);
     }
     return;
   }
 
-  writeBuffer.pop_front();
+  auto& metrics = serverImpl.metrics;
+  metrics.write.record(Clock::now() - writeStarted);
+  MetricsRecorder::increment(metrics.messagesOut, inFlight);
+  MetricsRecorder::increment(metrics.bytesOut, size);
+  dropQueued(0, inFlight);
+  inFlight = 0;
 
   // Continue asynchronously processing any further messages that have been
   // sent.
   if (!writeBuffer.empty()) {
-    websocket.async_write(boost::asio::buffer(writeBuffer.front()),
-      [this, self = shared_from_this()] (auto errorCode, std::size_t size) {
-        afterWrite(errorCode, size);
-      });
+    writePending();
+  } else if (draining) {
+    close();
   }
 }
 
 
+template <typename Executor>
 void
-Channel::readMessage() {
+BasicChannel<Executor>::readMessage() {
   auto self = shared_from_this();
   websocket.async_read(streamBuf,
     [this, self] (auto errorCode, std::size_t size) {
       if (!errorCode) {
-        auto message = boost::beast::buffers_to_string(streamBuf.data());
-        readBuffer.push_back({connection, std::move(message)});
+        touch();
+        if (admitIncoming(size)) {
+          auto type = websocket.got_binary() ? MessageType::BINARY : MessageType::TEXT;
+          serverImpl.pushIncoming(connection, streamBuf.cdata(), type);
+        }
         streamBuf.consume(streamBuf.size());
-        this->readMessage();
+        continueReading();
+      } else if (session && !disconnected) {
+        detach();
       } else if (!disconnected) {
-        serverImpl.server.disconnect(connection);
+        serverImpl.dropChannel(connection);
+        if (draining) {
+          finishDrain(false);
+        }
+      }
+    });
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::detach() {
+  // The websocket failed, but the Connection stays registered so that the
+  // Client can resume it. Messages that were not yet written wait in the
+  // Session. In flight messages were already recorded for replay.
+  disconnected = true;
+  detached = true;
+  throttleTimer.cancel();
+  auto generation = session->detach(writeBuffer.begin() + inFlight, writeBuffer.end());
+  dropQueued(0, writeBuffer.size());
+  inFlight = 0;
+  if (draining) {
+    finishDrain(false);
+  } else {
+    serverImpl.detachSession(session, generation);
+  }
+}
+
+
+template <typename Executor>
+bool
+BasicChannel<Executor>::admitIncoming(std::size_t size) {
+  switch (floodGuard.admit(size, Clock::now())) {
+    case FloodGuard::Verdict::ACCEPT:
+      return true;
+
+    case FloodGuard::Verdict::REJECT:
+      MetricsRecorder::increment(serverImpl.metrics.messagesRejected);
+      return false;
+
+    case FloodGuard::Verdict::DISCONNECT:
+      serverImpl.dropChannel(connection);
+      close();
+      return false;
+  }
+  return false;
+}
+
+
+template <typename Executor>
+void
+BasicChannel<Executor>::continueReading() {
+  if (disconnected) {
+    return;
+  }
+
+  auto pause = floodGuard.getPause();
+  if (pause <= Clock::duration::zero()) {
+    readMessage();
+    return;
+  }
+
+  // Leaving the socket unread lets TCP flow control slow the Client down.
+  MetricsRecorder::increment(serverImpl.metrics.readsThrottled);
+  throttleTimer.expires_after(pause);
+  throttleTimer.async_wait(
+    [this, self = shared_from_this()] (auto errorCode) {
+      if (!errorCode && !disconnected) {
+        readMessage();
       }
     });
 }
@@ -190,29 +827,35 @@ Channel::readMessage() {
 ////////////////////////////////////////////////////////////////////////////////
 
 
-class HTTPSession : public std::enable_shared_from_this<HTTPSession> {
+template <typename Executor>
+class HTTPSession : public std::enable_shared_from_this<HTTPSession<Executor>> {
 public:
-  HTTPSession(ServerImpl& serverImpl)
+  using Socket = boost::asio::basic_stream_socket<boost::asio::ip::tcp, Executor>;
+
+  HTTPSession(ServerImpl& serverImpl, Executor executor)
     : serverImpl{serverImpl},
-      socket{serverImpl.ioContext},
+      socket{std::move(executor)},
       streamBuf{}
       { }
 
   void start();
   void handleRequest();
+  void markAccepted() { acceptedAt = Clock::now(); }
 
-  boost::asio::ip::tcp::socket & getSocket() { return socket; }
+  Socket & getSocket() { return socket; }
 
 private:
   ServerImpl &serverImpl;
-  boost::asio::ip::tcp::socket socket;
+  Clock::time_point acceptedAt;
+  Socket socket;
   boost::beast::flat_buffer streamBuf;
   boost::beast::http::request<boost::beast::http::string_body> request;
 };
 
 
+template <typename Executor>
 void
-HTTPSession::start() {
+HTTPSession<Executor>::start() {
   boost::beast::http::async_read(socket, streamBuf, request,
     [this, session = this->shared_from_this()]
     (std::error_code ec, std::size_t /*bytes*/) {
@@ -220,18 +863,21 @@ HTTPSession::start() {
         serverImpl.reportError("Error reading from HTTP stream.");
 
       } else if (boost::beast::websocket::is_upgrade(request)) {
-        auto channel = std::make_shared<Channel>(std::move(socket), serverImpl);
+        auto channel =
+          std::make_shared<BasicChannel<Executor>>(std::move(socket), serverImpl, acceptedAt);
         channel->start(request);
 
       } else {
+        MetricsRecorder::increment(serverImpl.metrics.httpRequests);
         session->handleRequest();
       }
     });
 }
 
 
+template <typename Executor>
 void
-HTTPSession::handleRequest() {
+HTTPSession<Executor>::handleRequest() {
   auto send = [this, session = this->shared_from_this()] (auto&& response) {
     using Response = typename std::decay<decltype(response)>::type;
     auto sharedResponse =
@@ -273,9 +919,32 @@ HTTPSession::handleRequest() {
       method != boost::beast::http::verb::get
       && method != boost::beast::http::verb::head) {
     send(badRequest("Unknown HTTP-method"));
+    return;
+  }
+
+  // Query strings select nothing here, so they are ignored for matching.
+  auto target = request.target();
+  target = target.substr(0, target.find('?'));
+
+  if (serverImpl.options.serveMetrics && target == "/metrics") {
+    boost::beast::http::response<boost::beast::http::string_body> result {
+      boost::beast::http::status::ok,
+      request.version()
+    };
+    result.set(boost::beast::http::field::server, BOOST_BEAST_VERSION_STRING);
+    result.set(boost::beast::http::field::content_type,
+               "text/plain; version=0.0.4");
+    result.keep_alive(request.keep_alive());
+    if (request.method() == boost::beast::http::verb::get) {
+      result.body() = formatMetrics(serverImpl.server.getMetrics());
+    }
+    result.prepare_payload();
+    send(std::move(result));
+    return;
   }
 
-  // We only support index.html and /.
+  // Requests for index.html and / get the index page. Everything else must be
+  // a preloaded asset.
   auto shouldServeIndex = [] (auto target) {
     std::string const index = "/index.html"s;
     constexpr auto npos = boost::beast::string_view::npos;
@@ -284,37 +953,64 @@ HTTPSession::handleRequest() {
       || (index.size() <= target.size()
         && target.compare(target.size() - index.size(), npos, index) == 0);
   };
-  if (!shouldServeIndex(request.target())) {
+  const Asset* asset = shouldServeIndex(target)
+    ? &serverImpl.assets.getIndex()
+    : serverImpl.assets.find({target.data(), target.size()});
+  if (!asset) {
     send(badRequest("Illegal request-target"));
+    return;
   }
-       
-  boost::beast::http::string_body::value_type body = serverImpl.httpMessage;
+
+  auto acceptEncoding = request[boost::beast::http::field::accept_encoding];
+  auto [variant, encoding] =
+    asset->selectVariant({acceptEncoding.data(), acceptEncoding.size()});
 
   auto addResponseMetaData =
-    [bodySize = body.size(), &request = this->request] (auto& response) {
+    [asset = asset, variant = variant, encoding = encoding,
+     &request = this->request] (auto& response) {
     response.set(boost::beast::http::field::server, BOOST_BEAST_VERSION_STRING);
-    response.set(boost::beast::http::field::content_type, "text/html");
-    response.content_length(bodySize);
+    response.set(boost::beast::http::field::content_type, asset->contentType);
+    response.set(boost::beast::http::field::etag, variant->etag);
+    response.set(boost::beast::http::field::cache_control, "no-cache");
+    if (asset->gzip.body || asset->brotli.body) {
+      response.set(boost::beast::http::field::vary, "Accept-Encoding");
+    }
+    if (!encoding.empty()) {
+      response.set(boost::beast::http::field::content_encoding,
+                   {encoding.data(), encoding.size()});
+    }
     response.keep_alive(request.keep_alive());
   };
 
-  if (request.method() == boost::beast::http::verb::head) {
+  auto ifNoneMatch = request[boost::beast::http::field::if_none_match];
+  if (matchesETag({ifNoneMatch.data(), ifNoneMatch.size()}, variant->etag)) {
+    // The client's cached copy is still current.
+    boost::beast::http::response<boost::beast::http::empty_body> result {
+      boost::beast::http::status::not_modified,
+      request.version()
+    };
+    addResponseMetaData(result);
+    send(std::move(result));
+
+  } else if (request.method() == boost::beast::http::verb::head) {
     // Respond to HEAD
     boost::beast::http::response<boost::beast::http::empty_body> result {
       boost::beast::http::status::ok,
       request.version()
     };
     addResponseMetaData(result);
+    result.content_length(variant->body->size());
     send(std::move(result));
 
   } else {
-    // Respond to GET
-    boost::beast::http::response<boost::beast::http::string_body> result {
+    // Respond to GET. The body shares the cached buffer rather than copying.
+    boost::beast::http::response<SharedTextBody> result {
       std::piecewise_construct,
-      std::make_tuple(std::move(body)),
+      std::make_tuple(variant->body),
       std::make_tuple(boost::beast::http::status::ok, request.version())
     };
     addResponseMetaData(result);
+    result.content_length(variant->body->size());
     send(std::move(result));
   }
 }
@@ -327,12 +1023,26 @@ HTTPSession::handleRequest() {
 
 void
 ServerImpl::listenForConnections() {
-  auto session =
-    std::make_shared<HTTPSession>(*this);
+  if (usesStrands()) {
+    acceptConnection(std::make_shared<HTTPSession<StrandExecutor>>(
+      *this, boost::asio::make_strand(ioContext)));
+  } else {
+    acceptConnection(std::make_shared<HTTPSession<DirectExecutor>>(
+      *this, ioContext.get_executor()));
+  }
+}
+
 
+template <typename HTTPSessionPtr>
+void
+ServerImpl::acceptConnection(HTTPSessionPtr session) {
   acceptor.async_accept(session->getSocket(),
     [this, session] (auto errorCode) {
+      if (!accepting) {
+        return;
+      }
       if (!errorCode) {
+        session->markAccepted();
         session->start();
       } else {
         reportError("Fatal error while accepting");
@@ -342,17 +1052,294 @@ ServerImpl::listenForConnections() {
 }
 
 
+void
+ServerImpl::stopAccepting() {
+  accepting = false;
+  boost::asio::post(acceptor.get_executor(), [this] {
+    boost::beast::error_code ignored;
+    acceptor.close(ignored);
+  });
+}
+
+
+ServerImpl::~ServerImpl() {
+  ioContext.stop();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+
+void
+ServerImpl::startWorkers() {
+  workers.reserve(options.ioThreads);
+  for (unsigned i = 0; i < options.ioThreads; ++i) {
+    workers.emplace_back([this] {
+      // The work guard keeps run() from running out of work, so it only
+      // returns once the io_context has been stopped or a handler has thrown.
+      while (!ioContext.stopped()) {
+        try {
+          ioContext.run();
+        } catch (std::exception& e) {
+          reportError(e.what());
+        }
+      }
+    });
+  }
+}
+
+
 void
 ServerImpl::registerChannel(Channel& channel) {
-  auto connection = channel.getConnection();
-  channels[connection] = channel.shared_from_this();
-  server.connectionHandler->handleConnect(connection);
+  metrics.accept.record(Clock::now() - channel.getAcceptTime());
+  MetricsRecorder::increment(metrics.connectionsOpened);
+  {
+    std::lock_guard lock{channelLock};
+    Connection connection{channels.insert(channel.shared_from_this())};
+    channel.setConnection(connection);
+    connectionEvents.push_back({connection, true});
+    if (auto* session = channel.getSession()) {
+      session->open(connection, channel.weak_from_this());
+    }
+  }
+  signalConnectionEvent();
+}
+
+
+std::shared_ptr<Session>
+ServerImpl::createSession() {
+  std::lock_guard lock{sessionLock};
+  std::string token;
+  do {
+    char digits[33];
+    std::snprintf(digits, sizeof(digits), "%08x%08x%08x%08x",
+                  tokenSource(), tokenSource(), tokenSource(), tokenSource());
+    token = digits;
+  } while (sessions.count(token));
+  auto session = std::make_shared<Session>(std::move(token),
+                                           options.sessions.replayCapacity);
+  sessions.emplace(session->getToken(), session);
+  return session;
+}
+
+
+std::shared_ptr<Session>
+ServerImpl::findSession(std::string_view token) {
+  std::lock_guard lock{sessionLock};
+  auto found = sessions.find(token);
+  return sessions.end() == found ? nullptr : found->second;
+}
+
+
+void
+ServerImpl::endSession(Session& session) {
+  session.end();
+  std::lock_guard lock{sessionLock};
+  sessions.erase(session.getToken());
+}
+
+
+std::optional<std::deque<networking::Outgoing>>
+ServerImpl::resumeChannel(Channel& channel, Session& session, uint64_t received) {
+  auto connection = session.getConnection();
+  std::shared_ptr<Channel> previous;
+  std::optional<std::deque<Outgoing>> missed;
+  {
+    std::lock_guard lock{channelLock};
+    auto* slot = channels.find(connection.id);
+    if (!slot) {
+      return std::nullopt;
+    }
+    missed = session.resume(channel.weak_from_this(), received);
+    if (!missed) {
+      return std::nullopt;
+    }
+    // The new Channel takes over the slot, so the Connection is unchanged.
+    previous = std::exchange(*slot, channel.shared_from_this());
+    channel.setConnection(connection);
+  }
+  MetricsRecorder::increment(metrics.sessionsResumed);
+  return missed;
+}
+
+
+void
+ServerImpl::detachSession(std::shared_ptr<Session> session, uint64_t generation) {
+  std::lock_guard lock{channelLock};
+  detachedSessions.emplace_back(std::move(session), generation);
+}
+
+
+void
+ServerImpl::expireSession(Session& session, uint64_t generation) {
+  if (session.expire(generation)) {
+    {
+      std::lock_guard lock{sessionLock};
+      sessions.erase(session.getToken());
+    }
+    dropChannel(session.getConnection());
+  }
+}
+
+
+void
+ServerImpl::dropChannel(Connection connection) {
+  {
+    std::lock_guard lock{channelLock};
+    if (!channels.erase(connection.id)) {
+      return;
+    }
+    MetricsRecorder::increment(metrics.connectionsClosed);
+    connectionEvents.push_back({connection, false});
+  }
+  signalConnectionEvent();
+}
+
+
+void
+ServerImpl::signalConnectionEvent() {
+  {
+    std::lock_guard lock{incomingLock};
+    connectionEventsQueued = true;
+  }
+  incomingReady.notify_one();
+}
+
+
+void
+ServerImpl::pushIncoming(Connection connection,
+                         boost::asio::const_buffer text,
+                         MessageType type) {
+  std::lock_guard lock{incomingLock};
+  std::string storage;
+  if (!spareTexts.empty()) {
+    storage = std::move(spareTexts.back());
+    spareTexts.pop_back();
+  }
+  storage.assign(static_cast<const char*>(text.data()), text.size());
+  if (incoming.empty()) {
+    oldestIncoming = Clock::now();
+  }
+  incoming.push_back({connection, std::move(storage), type});
+  MetricsRecorder::increment(metrics.messagesIn);
+  MetricsRecorder::increment(metrics.bytesIn, text.size());
+  incomingReady.notify_one();
+}
+
+
+void
+ServerImpl::recycleIncoming(std::vector<Message>& messages) {
+  // Bound what the pool retains so that a burst of large messages does not
+  // pin that memory for the lifetime of the server.
+  constexpr std::size_t MAX_SPARE_TEXTS = 4096;
+  constexpr std::size_t MAX_SPARE_CAPACITY = 64 * 1024;
+  for (auto& message : messages) {
+    if (spareTexts.size() < MAX_SPARE_TEXTS
+        && message.text.capacity() <= MAX_SPARE_CAPACITY) {
+      spareTexts.push_back(std::move(message.text));
+    }
+  }
+  messages.clear();
+}
+
+
+void
+ServerImpl::deliverConnectionEvents() {
+  std::vector<ConnectionEvent> events;
+  std::vector<std::pair<std::shared_ptr<Session>, uint64_t>> detached;
+  {
+    std::lock_guard lock{channelLock};
+    std::swap(events, connectionEvents);
+    std::swap(detached, detachedSessions);
+  }
+  // Timers may only be scheduled from this thread.
+  for (auto& [session, generation] : detached) {
+    timers.schedule(Clock::now() + options.sessions.retention,
+      [this, session = std::move(session), generation = generation] {
+        expireSession(*session, generation);
+      });
+  }
+  // The handlers are user code and may call back into the Server, so they
+  // must be invoked without holding any locks.
+  for (auto [connection, connected] : events) {
+    if (connected) {
+      if (0 < options.idleTimeout.count()) {
+        watchIdle(connection);
+      }
+      server.connectionHandler->handleConnect(connection);
+    } else {
+      server.connectionHandler->handleDisconnect(connection);
+    }
+  }
+}
+
+
+void
+ServerImpl::fireTimers() {
+  timers.advance(Clock::now());
+}
+
+
+void
+ServerImpl::reportDrained(bool clean) {
+  std::lock_guard lock{drainLock};
+  if (0 == drainRemaining) {
+    // The drain already gave up and counted this Connection as forced.
+    return;
+  }
+  --drainRemaining;
+  if (clean) {
+    ++drainResult.closedCleanly;
+  } else {
+    ++drainResult.forced;
+  }
+  drainProgress.notify_all();
+}
+
+
+void
+ServerImpl::watchIdle(Connection connection) {
+  std::shared_ptr<Channel> channel;
+  {
+    std::lock_guard lock{channelLock};
+    auto* found = channels.find(connection.id);
+    if (!found) {
+      return;
+    }
+    channel = *found;
+  }
+
+  // Rather than resetting a timer on every message, the watch wakes at the
+  // earliest time that the Connection could have become idle and checks.
+  auto now = Clock::now();
+  auto lastActivity = channel->getLastActivity();
+  if (lastActivity + options.idleTimeout <= now) {
+    MetricsRecorder::increment(metrics.connectionsTimedOut);
+    server.disconnect(connection);
+    return;
+  }
+
+  auto nextCheck = lastActivity + options.idleTimeout / 2;
+  if (nextCheck <= now) {
+    channel->ping();
+    nextCheck = lastActivity + options.idleTimeout;
+  }
+  timers.schedule(nextCheck, [this, connection] { watchIdle(connection); });
+}
+
+
+void
+ServerImpl::recordReceipt() {
+  if (!incoming.empty()) {
+    metrics.read.record(Clock::now() - oldestIncoming);
+  }
 }
 
 
 void
 ServerImpl::reportError(std::string_view /*message*/) {
-  // Swallow errors....
+  // Errors are counted but otherwise swallowed....
+  MetricsRecorder::increment(metrics.errors);
 }
 
 void
@@ -370,49 +1357,270 @@ ServerImplDeleter::operator()(ServerImpl* serverImpl) {
 
 void
 Server::update() {
-  impl->ioContext.poll();
+  auto start = Clock::now();
+  if (!impl->isThreaded()) {
+    impl->ioContext.poll();
+  }
+  impl->deliverConnectionEvents();
+  impl->fireTimers();
+  impl->metrics.update.record(Clock::now() - start);
+}
+
+
+void
+Server::updateUntil(std::chrono::steady_clock::time_point deadline) {
+  if (auto nextTimer = impl->timers.getNextExpiry()) {
+    deadline = std::min(deadline, *nextTimer);
+  }
+
+  if (impl->isThreaded()) {
+    std::unique_lock lock{impl->incomingLock};
+    impl->incomingReady.wait_until(lock, deadline, [this] {
+      return !impl->incoming.empty() || impl->connectionEventsQueued;
+    });
+    // Events queued after this point set the flag again and are delivered
+    // by the next update if this one misses them.
+    impl->connectionEventsQueued = false;
+    lock.unlock();
+    auto start = Clock::now();
+    impl->deliverConnectionEvents();
+    impl->fireTimers();
+    impl->metrics.update.record(Clock::now() - start);
+    return;
+  }
+
+  auto& ioContext = impl->ioContext;
+  // Only this thread runs handlers in single threaded mode, so the queue and
+  // flag can be inspected without holding their lock.
+  while (impl->incoming.empty()
+      && !impl->connectionEventsQueued
+      && std::chrono::steady_clock::now() < deadline) {
+    // The work guard keeps the context from running out of work, so this
+    // only returns 0 when the context has been stopped.
+    if (0 == ioContext.run_one_until(deadline)) {
+      break;
+    }
+  }
+  impl->connectionEventsQueued = false;
+  auto start = Clock::now();
+  ioContext.poll();
+  impl->deliverConnectionEvents();
+  impl->fireTimers();
+  impl->metrics.update.record(Clock::now() - start);
+}
+
+
+networking::TimerHandle
+Server::addTimer(std::chrono::steady_clock::time_point deadline,
+                 std::function<void()> callback) {
+  return impl->timers.schedule(deadline, std::move(callback));
+}
+
+
+bool
+Server::cancelTimer(TimerHandle handle) {
+  return impl->timers.cancel(handle);
 }
 
 
 std::deque<Message>
 Server::receive() {
-  std::deque<Message> oldIncoming;
-  std::swap(oldIncoming, impl->incoming);
+  // Deliver connects first so that no Message arrives from a Connection that
+  // the connection handler has not yet seen.
+  impl->deliverConnectionEvents();
+  std::lock_guard lock{impl->incomingLock};
+  impl->recordReceipt();
+  std::deque<Message> oldIncoming{std::make_move_iterator(impl->incoming.begin()),
+                                  std::make_move_iterator(impl->incoming.end())};
+  impl->incoming.clear();
   return oldIncoming;
 }
 
 
+void
+Server::receive(std::vector<Message>& messages) {
+  impl->deliverConnectionEvents();
+  std::lock_guard lock{impl->incomingLock};
+  impl->recordReceipt();
+  impl->recycleIncoming(messages);
+  // Swapping hands the caller's storage back to the Server for the next batch
+  // so that neither vector needs to reallocate in the steady state.
+  std::swap(messages, impl->incoming);
+}
+
+
 void
 Server::send(const std::deque<Message>& messages) {
+  std::lock_guard lock{impl->channelLock};
   for (auto& message : messages) {
-    auto found = impl->channels.find(message.connection);
-    if (impl->channels.end() != found) {
-      found->second->send(message.text);
+    if (auto* channel = impl->channels.find(message.connection.id)) {
+      (*channel)->send(std::make_shared<const std::string>(message.text),
+                          message.type);
+    }
+  }
+}
+
+
+void
+Server::broadcast(SharedText text,
+                  const std::vector<Connection>& connections,
+                  MessageType type) {
+  if (!impl->isThreaded() || impl->usesStrands()) {
+    // Without I/O threads every Channel queues the text directly. With a
+    // strand per Channel there is nothing to share, so each gets a post.
+    std::lock_guard lock{impl->channelLock};
+    for (auto connection : connections) {
+      if (auto* channel = impl->channels.find(connection.id)) {
+        (*channel)->send(text, type);
+      }
     }
+    return;
   }
+
+  // A single I/O thread serves every Channel, so one handler can queue the
+  // text for all of them.
+  std::vector<std::shared_ptr<Channel>> recipients;
+  recipients.reserve(connections.size());
+  {
+    std::lock_guard lock{impl->channelLock};
+    for (auto connection : connections) {
+      if (auto* channel = impl->channels.find(connection.id)) {
+        recipients.push_back(*channel);
+      }
+    }
+  }
+  boost::asio::post(impl->ioContext,
+    [recipients = std::move(recipients), text = std::move(text), type] {
+      for (auto& channel : recipients) {
+        channel->sendOnExecutor(text, type);
+      }
+    });
 }
 
 
 void
 Server::disconnect(Connection connection) {
-  auto found = impl->channels.find(connection);
-  if (impl->channels.end() != found) {
-    connectionHandler->handleDisconnect(connection);
-    found->second->disconnect();
-    impl->channels.erase(found);
+  std::shared_ptr<Channel> channel;
+  {
+    std::lock_guard lock{impl->channelLock};
+    auto* found = impl->channels.find(connection.id);
+    if (!found) {
+      return;
+    }
+    channel = std::move(*found);
+    impl->channels.erase(connection.id);
   }
+  MetricsRecorder::increment(impl->metrics.connectionsClosed);
+  connectionHandler->handleDisconnect(connection);
+  channel->disconnect();
+}
+
+
+networking::DrainResult
+Server::drain(std::chrono::steady_clock::duration timeout) {
+  auto deadline = Clock::now() + timeout;
+  impl->stopAccepting();
+
+  std::vector<std::shared_ptr<Channel>> draining;
+  {
+    std::lock_guard lock{impl->channelLock};
+    draining.assign(impl->channels.begin(), impl->channels.end());
+  }
+  {
+    std::lock_guard lock{impl->drainLock};
+    impl->drainRemaining = draining.size();
+    impl->drainResult = {};
+  }
+  for (auto& channel : draining) {
+    channel->drain();
+  }
+
+  auto isDrained = [this] { return 0 == impl->drainRemaining; };
+  if (impl->isThreaded()) {
+    std::unique_lock lock{impl->drainLock};
+    impl->drainProgress.wait_until(lock, deadline, isDrained);
+  } else {
+    // Handlers only run on this thread, so the count can be read unlocked.
+    while (!isDrained() && Clock::now() < deadline) {
+      if (0 == impl->ioContext.run_one_until(deadline)) {
+        break;
+      }
+    }
+  }
+
+  DrainResult result;
+  {
+    std::lock_guard lock{impl->drainLock};
+    impl->drainResult.forced += impl->drainRemaining;
+    impl->drainRemaining = 0;
+    result = impl->drainResult;
+  }
+  for (auto& channel : draining) {
+    channel->forceClose();
+    impl->dropChannel(channel->getConnection());
+  }
+  if (!impl->isThreaded()) {
+    impl->ioContext.poll();
+  }
+  impl->deliverConnectionEvents();
+  return result;
+}
+
+
+QueueDepth
+Server::getQueueDepth(Connection connection) const {
+  std::lock_guard lock{impl->channelLock};
+  auto* channel = impl->channels.find(connection.id);
+  return channel ? (*channel)->getQueueDepth() : QueueDepth{};
+}
+
+
+void
+Server::setQueueLimits(Connection connection, QueueLimits limits) {
+  std::lock_guard lock{impl->channelLock};
+  if (auto* channel = impl->channels.find(connection.id)) {
+    (*channel)->setQueueLimits(limits);
+  }
+}
+
+
+void
+Server::setRateLimits(Connection connection, RateLimits limits) {
+  std::lock_guard lock{impl->channelLock};
+  if (auto* channel = impl->channels.find(connection.id)) {
+    (*channel)->setRateLimits(limits);
+  }
+}
+
+
+void
+Server::setOverflowPolicy(OverflowPolicy policy) {
+  impl->overflowPolicy.store(policy, std::memory_order_relaxed);
+}
+
+
+ServerMetrics
+Server::getMetrics() const {
+  auto result = impl->metrics.snapshot();
+  std::lock_guard lock{impl->channelLock};
+  for (auto& channel : impl->channels) {
+    auto [messages, bytes] = channel->getQueueDepth();
+    result.queuedMessages += messages;
+    result.queuedBytes += bytes;
+  }
+  return result;
 }
 
 
 std::unique_ptr<ServerImpl,ServerImplDeleter>
 Server::buildImpl(Server& server,
                   unsigned short port,
-                  std::string httpMessage) {
+                  std::string httpMessage,
+                  ServerOptions options) {
   // NOTE: We are using a custom deleter here so that the impl class can be
   // hidden within the source file rather than exposed in the header. Using
   // a custom deleter means that we need to use a raw `new` rather than using
   // `std::make_unique`.
-  auto* impl = new ServerImpl(server, port, std::move(httpMessage));
+  auto* impl = new ServerImpl(server, port, std::move(httpMessage), options);
   return std::unique_ptr<ServerImpl,ServerImplDeleter>(impl);
 }
-
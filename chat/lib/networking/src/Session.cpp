@@ -0,0 +1,124 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "Session.h"
+
+#include <iterator>
+
+using networking::Channel;
+using networking::Connection;
+using networking::Outgoing;
+using networking::Session;
+
+
+Connection
+Session::getConnection() const {
+  std::lock_guard guard{lock};
+  return connection;
+}
+
+
+void
+Session::open(Connection assigned, std::weak_ptr<Channel> channel) {
+  std::lock_guard guard{lock};
+  connection = assigned;
+  current = std::move(channel);
+  opened = true;
+}
+
+
+void
+Session::recordWritten(const Outgoing& outgoing) {
+  std::lock_guard guard{lock};
+  replay.push_back(outgoing);
+  if (capacity < replay.size()) {
+    replay.pop_front();
+  }
+  ++written;
+}
+
+
+std::shared_ptr<Channel>
+Session::parkOrForward(Outgoing outgoing) {
+  std::lock_guard guard{lock};
+  if (auto next = current.lock()) {
+    return next;
+  }
+  if (!ended) {
+    pending.push_back(std::move(outgoing));
+    trimPending();
+  }
+  return nullptr;
+}
+
+
+bool
+Session::isResumable(uint64_t received) const {
+  // Every message after `received` must still be in the ring.
+  return !ended
+    && current.expired()
+    && received <= written
+    && written - received <= replay.size();
+}
+
+
+std::optional<std::deque<Outgoing>>
+Session::resume(std::weak_ptr<Channel> channel, uint64_t received) {
+  std::lock_guard guard{lock};
+  if (!opened || !isResumable(received)) {
+    return std::nullopt;
+  }
+
+  // The missed messages are recorded again as they are rewritten, so they
+  // leave the ring and the count rewinds to what the Client has.
+  auto missedBegin = replay.end() - (written - received);
+  std::deque<Outgoing> missed{std::make_move_iterator(missedBegin),
+                              std::make_move_iterator(replay.end())};
+  replay.erase(missedBegin, replay.end());
+  written = received;
+
+  missed.insert(missed.end(), std::make_move_iterator(pending.begin()),
+                std::make_move_iterator(pending.end()));
+  pending.clear();
+  current = std::move(channel);
+  ++detachGeneration;
+  return missed;
+}
+
+
+bool
+Session::expire(uint64_t generation) {
+  std::lock_guard guard{lock};
+  if (ended || generation != detachGeneration || !current.expired()) {
+    return false;
+  }
+  ended = true;
+  pending.clear();
+  replay.clear();
+  return true;
+}
+
+
+void
+Session::end() {
+  std::lock_guard guard{lock};
+  ended = true;
+  pending.clear();
+  replay.clear();
+}
+
+
+void
+Session::trimPending() {
+  // A Client that stays away too long loses the oldest parked messages, just
+  // as the ring forgets the oldest written ones.
+  while (capacity < pending.size()) {
+    pending.pop_front();
+  }
+}
+
@@ -0,0 +1,141 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_SESSION_H
+#define NETWORKING_SESSION_H
+
+#include "Server.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+
+namespace networking {
+
+
+class Channel;
+
+
+// The handshake response header that carries a Session's token, and the
+// query parameters with which a reconnecting Client asks to resume it.
+inline constexpr char SESSION_TOKEN_HEADER[] = "X-Session-Token";
+inline constexpr char SESSION_PARAMETER[] = "session";
+inline constexpr char RECEIVED_PARAMETER[] = "received";
+
+
+/**
+ *  A message queued for a Connection. The payload may be shared with other
+ *  Connections.
+ */
+struct Outgoing {
+  SharedText text;
+  MessageType type;
+};
+
+
+/**
+ *  @class Session
+ *
+ *  @brief The resumable state of a Connection, which outlives the websocket
+ *  of any single Channel.
+ *
+ *  A Session remembers the most recently written messages in a bounded ring
+ *  and numbers every written message. When its Channel fails, the Session
+ *  is detached, and messages sent in the meantime are parked. A new Channel
+ *  that reports how many messages it received can then take over the
+ *  Session, and only the messages it missed are sent again.
+ *
+ *  Sessions are shared between the strands of old and new Channels and the
+ *  thread that owns the Server, so every member function is thread safe.
+ */
+class Session {
+public:
+  Session(std::string token, std::size_t capacity)
+    : token{std::move(token)},
+      capacity{std::max<std::size_t>(1, capacity)}
+      { }
+
+  [[nodiscard]] const std::string& getToken() const noexcept { return token; }
+
+  [[nodiscard]] Connection getConnection() const;
+
+  /** Attach the first Channel of the Session. */
+  void open(Connection connection, std::weak_ptr<Channel> channel);
+
+  /** Remember a message as it starts being written to the Client. */
+  void recordWritten(const Outgoing& outgoing);
+
+  /**
+   *  Detach the failed Channel, parking its unwritten messages. Returns the
+   *  generation of the detachment, for use with expire().
+   */
+  template <typename Iterator>
+  uint64_t
+  detach(Iterator unwrittenBegin, Iterator unwrittenEnd) {
+    std::lock_guard guard{lock};
+    current.reset();
+    pending.insert(pending.end(), unwrittenBegin, unwrittenEnd);
+    trimPending();
+    return ++detachGeneration;
+  }
+
+  /**
+   *  Park a message sent while detached. If another Channel has already
+   *  taken over the Session, that Channel is returned and the message should
+   *  be sent to it instead.
+   */
+  [[nodiscard]] std::shared_ptr<Channel> parkOrForward(Outgoing outgoing);
+
+  /**
+   *  Attach a new Channel to a detached Session, returning the messages that
+   *  the Client missed in the order to send them. Returns nothing if the
+   *  Session has ended, is attached elsewhere, or no longer holds every
+   *  missed message.
+   */
+  [[nodiscard]] std::optional<std::deque<Outgoing>>
+  resume(std::weak_ptr<Channel> channel, uint64_t received);
+
+  /**
+   *  End the Session if it is still detached from the given detachment.
+   *  Returns whether it ended.
+   */
+  bool expire(uint64_t generation);
+
+  /** End the Session so that it cannot be resumed. */
+  void end();
+
+private:
+  [[nodiscard]] bool isResumable(uint64_t received) const;
+  void trimPending();
+
+  const std::string token;
+  const std::size_t capacity;
+
+  mutable std::mutex lock;
+  Connection connection{0};
+  std::weak_ptr<Channel> current;
+  bool opened = false;
+  bool ended = false;
+  uint64_t detachGeneration = 0;
+
+  // The last `capacity` written messages, ending with message `written - 1`.
+  std::deque<Outgoing> replay;
+  uint64_t written = 0;
+  // Messages sent while detached that were never written.
+  std::deque<Outgoing> pending;
+};
+
+
+}
+
+
+#endif
+
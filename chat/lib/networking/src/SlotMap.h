@@ -0,0 +1,146 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_SLOT_MAP_H
+#define NETWORKING_SLOT_MAP_H
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+
+namespace networking {
+
+
+/**
+ *  @class SlotMap
+ *
+ *  @brief A container that hands out stable 64 bit keys for its values.
+ *
+ *  A key holds a slot index in its low 32 bits and the generation of that
+ *  slot in its high 32 bits. Lookups index straight into an array, and
+ *  reusing a slot bumps its generation, so keys to erased values never find
+ *  the value that replaced them. Values are stored contiguously for fast
+ *  iteration, and erasing moves the last value into the hole, so iteration
+ *  order is unspecified. No key is ever 0.
+ *
+ *  After a slot has been reused as many times as a Generation can count, its
+ *  generation wraps around, skipping 0. Narrower generations wrap sooner and
+ *  exist so that this can be tested.
+ */
+template <typename T, typename Generation = uint32_t>
+class SlotMap {
+  static_assert(std::is_unsigned_v<Generation> && sizeof(Generation) <= 4);
+
+public:
+  using Key = uint64_t;
+
+  Key
+  insert(T value) {
+    uint32_t index;
+    if (freeList != NONE) {
+      index = freeList;
+      freeList = slots[index].position;
+    } else {
+      index = slots.size();
+      slots.push_back(Slot{NONE, 1});
+    }
+
+    auto& slot = slots[index];
+    slot.position = values.size();
+    values.push_back(std::move(value));
+    owners.push_back(index);
+    return makeKey(index, slot.generation);
+  }
+
+  [[nodiscard]] T*
+  find(Key key) noexcept {
+    auto* slot = getSlot(key);
+    return slot ? &values[slot->position] : nullptr;
+  }
+
+  [[nodiscard]] const T*
+  find(Key key) const noexcept {
+    auto* slot = const_cast<SlotMap*>(this)->getSlot(key);
+    return slot ? &values[slot->position] : nullptr;
+  }
+
+  bool
+  erase(Key key) {
+    auto* slot = getSlot(key);
+    if (!slot) {
+      return false;
+    }
+
+    auto position = slot->position;
+    if (position + 1 != values.size()) {
+      values[position] = std::move(values.back());
+      owners[position] = owners.back();
+      slots[owners[position]].position = position;
+    }
+    values.pop_back();
+    owners.pop_back();
+
+    auto index = static_cast<uint32_t>(key);
+    // Generation 0 is skipped so that no key is 0.
+    auto next = static_cast<Generation>(slot->generation + 1);
+    slot->generation = next ? next : 1;
+    slot->position = freeList;
+    freeList = index;
+    return true;
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return values.size(); }
+  [[nodiscard]] bool empty() const noexcept { return values.empty(); }
+
+  auto begin() noexcept { return values.begin(); }
+  auto end() noexcept { return values.end(); }
+  auto begin() const noexcept { return values.begin(); }
+  auto end() const noexcept { return values.end(); }
+
+private:
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+  struct Slot {
+    // The value's index in `values` when occupied, and the next free slot
+    // otherwise.
+    uint32_t position;
+    Generation generation;
+  };
+
+  static Key
+  makeKey(uint32_t index, Generation generation) noexcept {
+    return (Key{generation} << 32) | index;
+  }
+
+  Slot*
+  getSlot(Key key) noexcept {
+    auto index = static_cast<uint32_t>(key);
+    auto generation = key >> 32;
+    // A free slot can only match a forged key, so also check ownership.
+    if (slots.size() <= index || slots[index].generation != generation
+        || owners.size() <= slots[index].position
+        || owners[slots[index].position] != index) {
+      return nullptr;
+    }
+    return &slots[index];
+  }
+
+  std::vector<Slot> slots;
+  std::vector<T> values;
+  // The slot index of each value, so that erasing can patch the moved value.
+  std::vector<uint32_t> owners;
+  uint32_t freeList = NONE;
+};
+
+
+}
+
+
+#endif
+
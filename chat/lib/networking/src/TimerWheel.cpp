@@ -0,0 +1,263 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+using networking::TimerHandle;
+using networking::TimerWheel;
+
+
+namespace {
+
+
+using Tick = std::chrono::milliseconds;
+
+
+// Return the distance from `from` to the next set bit at or after it, wrapping
+// around, or nothing if no bits are set.
+template <std::size_t N>
+std::optional<unsigned>
+findNextOccupied(const std::array<uint64_t, N>& bits, unsigned from) {
+  constexpr unsigned BIT_COUNT = N * 64;
+  for (unsigned scanned = 0; scanned < BIT_COUNT; ) {
+    unsigned position = (from + scanned) % BIT_COUNT;
+    uint64_t word = bits[position / 64] >> (position % 64);
+    if (word != 0) {
+      return scanned + __builtin_ctzll(word);
+    }
+    scanned += 64 - position % 64;
+  }
+  return std::nullopt;
+}
+
+
+}
+
+
+TimerWheel::TimerWheel(Clock::time_point start)
+  : start{start} {
+  for (auto& level : levels) {
+    level.heads.fill(NONE);
+  }
+}
+
+
+uint64_t
+TimerWheel::toTick(Clock::time_point time) const {
+  if (time <= start) {
+    return 0;
+  }
+  // Round up so that a timer never fires before its deadline.
+  return std::chrono::ceil<Tick>(time - start).count();
+}
+
+
+TimerWheel::Clock::time_point
+TimerWheel::toTime(uint64_t tick) const {
+  return start + Tick{tick};
+}
+
+
+TimerHandle
+TimerWheel::schedule(Clock::time_point deadline, Callback callback) {
+  uint32_t index;
+  if (freeList != NONE) {
+    index = freeList;
+    freeList = nodes[index].next;
+  } else {
+    index = nodes.size();
+    nodes.emplace_back();
+  }
+
+  auto& node = nodes[index];
+  node.callback = std::move(callback);
+  // The current slot has already fired, so the earliest a timer can fire is
+  // the next tick.
+  node.expiry = std::max(toTick(deadline), currentTick + 1);
+  node.active = true;
+  link(index);
+  ++pending;
+  return TimerHandle{index, node.generation};
+}
+
+
+bool
+TimerWheel::cancel(TimerHandle handle) {
+  if (nodes.size() <= handle.index) {
+    return false;
+  }
+  auto& node = nodes[handle.index];
+  if (!node.active || node.generation != handle.generation) {
+    return false;
+  }
+  unlink(handle.index);
+  release(handle.index);
+  return true;
+}
+
+
+void
+TimerWheel::link(uint32_t index) {
+  auto& node = nodes[index];
+
+  // A timer goes in the lowest level whose span reaches its expiry. Timers
+  // beyond the top level are parked at its far end and are re-linked when
+  // that slot cascades.
+  uint64_t delta = node.expiry - currentTick;
+  unsigned level = 0;
+  while (level + 1 < LEVEL_COUNT && (uint64_t{1} << (SLOT_BITS * (level + 1))) <= delta) {
+    ++level;
+  }
+  uint64_t target = node.expiry;
+  uint64_t span = uint64_t{1} << (SLOT_BITS * LEVEL_COUNT);
+  if (span <= delta) {
+    target = currentTick + span - 1;
+  }
+  unsigned slot = (target >> (SLOT_BITS * level)) % SLOT_COUNT;
+
+  auto& wheelLevel = levels[level];
+  node.level = level;
+  node.slot = slot;
+  node.previous = NONE;
+  node.next = wheelLevel.heads[slot];
+  if (node.next != NONE) {
+    nodes[node.next].previous = index;
+  }
+  wheelLevel.heads[slot] = index;
+  wheelLevel.occupied[slot / 64] |= uint64_t{1} << (slot % 64);
+}
+
+
+void
+TimerWheel::unlink(uint32_t index) {
+  auto& node = nodes[index];
+  auto& wheelLevel = levels[node.level];
+  if (node.previous != NONE) {
+    nodes[node.previous].next = node.next;
+  } else {
+    wheelLevel.heads[node.slot] = node.next;
+    if (node.next == NONE) {
+      wheelLevel.occupied[node.slot / 64] &= ~(uint64_t{1} << (node.slot % 64));
+    }
+  }
+  if (node.next != NONE) {
+    nodes[node.next].previous = node.previous;
+  }
+}
+
+
+void
+TimerWheel::release(uint32_t index) {
+  auto& node = nodes[index];
+  node.callback = nullptr;
+  node.active = false;
+  ++node.generation;
+  node.next = freeList;
+  freeList = index;
+  --pending;
+}
+
+
+void
+TimerWheel::cascade(unsigned level) {
+  unsigned slot = (currentTick >> (SLOT_BITS * level)) % SLOT_COUNT;
+  auto& wheelLevel = levels[level];
+  uint32_t index = wheelLevel.heads[slot];
+  wheelLevel.heads[slot] = NONE;
+  wheelLevel.occupied[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+  while (index != NONE) {
+    uint32_t next = nodes[index].next;
+    link(index);
+    index = next;
+  }
+}
+
+
+std::size_t
+TimerWheel::fireCurrentSlot() {
+  unsigned slot = currentTick % SLOT_COUNT;
+  auto& heads = levels[0].heads;
+  std::size_t fired = 0;
+  // Callbacks may cancel other timers in this slot, so the list is re-read
+  // from its head after every call.
+  while (heads[slot] != NONE) {
+    uint32_t index = heads[slot];
+    unlink(index);
+    auto callback = std::move(nodes[index].callback);
+    release(index);
+    callback();
+    ++fired;
+  }
+  return fired;
+}
+
+
+std::size_t
+TimerWheel::advance(Clock::time_point now) {
+  // Only whole elapsed milliseconds count, so no timer fires early.
+  uint64_t target = now <= start
+    ? 0
+    : std::chrono::floor<Tick>(now - start).count();
+
+  std::size_t fired = 0;
+  while (currentTick < target) {
+    if (pending == 0) {
+      currentTick = target;
+      break;
+    }
+
+    // Nothing fires or cascades before the next occupied slot, so the ticks
+    // in between are skipped rather than stepped through one at a time.
+    auto next = getNextEventTick();
+    if (!next || target < *next) {
+      currentTick = target;
+      break;
+    }
+    currentTick = *next;
+    for (unsigned level = LEVEL_COUNT - 1; 0 < level; --level) {
+      uint64_t mask = (uint64_t{1} << (SLOT_BITS * level)) - 1;
+      if ((currentTick & mask) == 0) {
+        cascade(level);
+      }
+    }
+    fired += fireCurrentSlot();
+  }
+  return fired;
+}
+
+
+std::optional<uint64_t>
+TimerWheel::getNextEventTick() const {
+  // Within the first level the slot gives the exact expiry. In higher levels
+  // it gives the tick at which the slot cascades, which is a lower bound.
+  std::optional<uint64_t> earliest;
+  for (unsigned level = 0; level < LEVEL_COUNT; ++level) {
+    unsigned shift = SLOT_BITS * level;
+    uint64_t base = currentTick >> shift;
+    auto distance = findNextOccupied(levels[level].occupied, (base + 1) % SLOT_COUNT);
+    if (!distance) {
+      continue;
+    }
+    uint64_t tick = (base + 1 + *distance) << shift;
+    if (!earliest || tick < *earliest) {
+      earliest = tick;
+    }
+  }
+  return earliest;
+}
+
+
+std::optional<TimerWheel::Clock::time_point>
+TimerWheel::getNextExpiry() const {
+  if (pending == 0) {
+    return std::nullopt;
+  }
+  return toTime(*getNextEventTick());
+}
@@ -0,0 +1,81 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef NETWORKING_TOKEN_BUCKET_H
+#define NETWORKING_TOKEN_BUCKET_H
+
+#include <algorithm>
+#include <chrono>
+
+
+namespace networking {
+
+
+/**
+ *  A token bucket that refills continuously at a fixed rate up to a fixed
+ *  capacity. A bucket with a rate of 0 is unlimited. Tokens may be taken
+ *  past empty, leaving a debt that must be repaid before more are available.
+ */
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  TokenBucket() = default;
+
+  TokenBucket(double rate, double capacity, Clock::time_point now)
+    : rate{rate},
+      // With no explicit burst, allow one second's worth at once.
+      capacity{0 < capacity ? capacity : std::max(1.0, rate)},
+      tokens{this->capacity},
+      lastRefill{now}
+      { }
+
+  void
+  refill(Clock::time_point now) noexcept {
+    std::chrono::duration<double> elapsed = now - lastRefill;
+    tokens = std::min(capacity, tokens + rate * elapsed.count());
+    lastRefill = now;
+  }
+
+  /** Whether `amount` tokens are available. Amounts beyond the capacity only
+   *  require a full bucket, so that they are not rejected forever. */
+  [[nodiscard]] bool
+  canTake(double amount) const noexcept {
+    return rate <= 0 || std::min(amount, capacity) <= tokens;
+  }
+
+  void
+  take(double amount) noexcept {
+    if (0 < rate) {
+      tokens -= amount;
+    }
+  }
+
+  /** How long until the bucket is out of debt. */
+  [[nodiscard]] Clock::duration
+  getDebtDuration() const noexcept {
+    if (rate <= 0 || 0 <= tokens) {
+      return Clock::duration::zero();
+    }
+    return std::chrono::ceil<Clock::duration>(
+      std::chrono::duration<double>{-tokens / rate});
+  }
+
+private:
+  double rate = 0;
+  double capacity = 0;
+  double tokens = 0;
+  Clock::time_point lastRefill;
+};
+
+
+}
+
+
+#endif
+
@@ -0,0 +1,76 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SCHEDULING_GAME_H
+#define SCHEDULING_GAME_H
+
+#include "RoomManager.h"
+#include "Server.h"
+
+#include <deque>
+#include <vector>
+
+
+namespace scheduling {
+
+
+/**
+ *  A message for every member of a room. The text is shared by all of the
+ *  recipients rather than copied for each of them.
+ */
+struct RoomBroadcast {
+  networking::RoomId room;
+  networking::SharedText text;
+  networking::MessageType type = networking::MessageType::TEXT;
+};
+
+
+/**
+ *  Everything that a game sends during a tick. Individual messages go to
+ *  `messages`, and messages for whole rooms go to `broadcasts`.
+ */
+struct Outbox {
+  std::deque<networking::Message> messages;
+  std::vector<RoomBroadcast> broadcasts;
+
+  void
+  clear() {
+    messages.clear();
+    broadcasts.clear();
+  }
+};
+
+
+/**
+ *  @class Game
+ *
+ *  @brief A single hosted game, advanced one tick at a time by a
+ *  GameScheduler.
+ *
+ *  Different games may tick at the same time on different threads, but a
+ *  single game never ticks concurrently with itself. A game should only touch
+ *  its own state and other thread safe objects while ticking.
+ */
+class Game {
+public:
+  virtual ~Game() = default;
+
+  /**
+   *  Process the messages sent to this game since its last tick, appending any
+   *  messages that should be sent to clients to `outbox`.
+   */
+  virtual void tick(const std::vector<networking::Message>& inbox,
+                    Outbox& outbox) = 0;
+};
+
+
+}
+
+
+#endif
+
@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SCHEDULING_GAME_SCHEDULER_H
+#define SCHEDULING_GAME_SCHEDULER_H
+
+#include "Game.h"
+#include "RoomManager.h"
+#include "WorkStealingPool.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace scheduling {
+
+
+/**
+ *  Games are identified by the room that their players are in.
+ */
+using GameId = networking::RoomId;
+
+
+/**
+ *  @class GameScheduler
+ *
+ *  @brief Hosts many games and ticks them in parallel.
+ *
+ *  Each incoming Message is routed to the inbox of the game for its sender's
+ *  room. A tick then runs every game on a WorkStealingPool and merges their
+ *  outboxes into a single Outbox.
+ *
+ *  Adding, removing, routing, and ticking must all happen on one thread,
+ *  typically the thread that owns the Server.
+ */
+class GameScheduler {
+public:
+  /**
+   *  Construct a scheduler that routes by the given rooms and ticks games on
+   *  the given number of threads. With 0, one thread is used per hardware
+   *  thread.
+   */
+  explicit GameScheduler(const networking::RoomManager& rooms,
+                         unsigned threadCount = 0);
+
+  /**
+   *  Host a game for the given room, replacing any game already there.
+   */
+  void addGame(GameId id, std::unique_ptr<Game> game);
+
+  /**
+   *  Stop hosting the game for the given room. Undelivered messages in its
+   *  inbox are discarded.
+   */
+  void removeGame(GameId id);
+
+  [[nodiscard]] bool hasGame(GameId id) const;
+
+  [[nodiscard]] std::size_t getGameCount() const noexcept { return slots.size(); }
+
+  /**
+   *  Copy each message in `incoming` to the inbox of its sender's game.
+   *  Messages from connections without a game are appended to `unrouted`.
+   *  `incoming` is left untouched, so it can be passed back to
+   *  Server::receive() to recycle the storage of its texts. The copies reuse
+   *  the storage of messages from earlier ticks, so steady state routing
+   *  does not allocate either.
+   */
+  void route(const std::vector<networking::Message>& incoming,
+             std::vector<networking::Message>& unrouted);
+
+  /**
+   *  Tick every hosted game once and append everything that they sent to
+   *  `outgoing`. The messages can then be passed to `Server::send` and the
+   *  broadcasts to `RoomManager::broadcast`. Messages from one game keep
+   *  their order, and the outboxes of different games are merged in a
+   *  stable order.
+   */
+  void tick(Outbox& outgoing);
+
+private:
+  [[nodiscard]] networking::Message copyMessage(const networking::Message& message);
+
+  struct Slot {
+    GameId id;
+    std::unique_ptr<Game> game;
+    std::vector<networking::Message> inbox;
+    Outbox outbox;
+  };
+
+  const networking::RoomManager& rooms;
+  WorkStealingPool pool;
+
+  // Games are kept dense so that a tick can hand out indices to the pool.
+  std::vector<Slot> slots;
+  std::unordered_map<GameId, std::size_t> positions;
+
+  // Strings from inbox messages that have already been ticked, whose
+  // storage is reused when copying newly routed messages.
+  std::vector<std::string> spareTexts;
+};
+
+
+}
+
+
+#endif
+
@@ -0,0 +1,88 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SCHEDULING_WORK_STEALING_POOL_H
+#define SCHEDULING_WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace scheduling {
+
+
+/**
+ *  @class WorkStealingPool
+ *
+ *  @brief A fixed set of threads for running batches of independent tasks.
+ *
+ *  The tasks of a batch are dealt out evenly to per-thread queues. A thread
+ *  takes work from the front of its own queue and, once that is empty, steals
+ *  from the back of the others. One slow task therefore only delays the thread
+ *  running it rather than every task queued behind it.
+ */
+class WorkStealingPool {
+public:
+  /**
+   *  Construct a pool using the given number of threads, including the thread
+   *  that calls parallelFor. With 0, one thread is used per hardware thread.
+   */
+  explicit WorkStealingPool(unsigned threadCount = 0);
+
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  /**
+   *  Call `task(i)` for every i in [0, count) and return once all calls are
+   *  complete. The calling thread helps run the batch. If any call throws,
+   *  the first exception is rethrown here after the batch finishes.
+   */
+  void parallelFor(std::size_t count, const std::function<void(std::size_t)>& task);
+
+  [[nodiscard]] unsigned getThreadCount() const noexcept { return queues.size(); }
+
+private:
+  struct TaskQueue {
+    std::mutex lock;
+    std::deque<std::size_t> indices;
+  };
+
+  void workerLoop(std::size_t self);
+  bool runOne(std::size_t self);
+  bool popOwn(std::size_t self, std::size_t& index);
+  bool steal(std::size_t self, std::size_t& index);
+
+  std::vector<std::unique_ptr<TaskQueue>> queues;
+  const std::function<void(std::size_t)>* currentTask = nullptr;
+  std::atomic<std::size_t> remaining = 0;
+
+  std::mutex batchLock;
+  std::condition_variable batchReady;
+  std::condition_variable batchDone;
+  uint64_t batch = 0;
+  bool stopping = false;
+  std::exception_ptr failure;
+
+  std::vector<std::thread> workers;
+};
+
+
+}
+
+
+#endif
+
@@ -0,0 +1,110 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "GameScheduler.h"
+
+#include <iterator>
+
+using networking::Message;
+using networking::RoomManager;
+using scheduling::Game;
+using scheduling::GameId;
+using scheduling::GameScheduler;
+using scheduling::Outbox;
+
+
+GameScheduler::GameScheduler(const RoomManager& rooms, unsigned threadCount)
+  : rooms{rooms},
+    pool{threadCount}
+    { }
+
+
+void
+GameScheduler::addGame(GameId id, std::unique_ptr<Game> game) {
+  auto [found, inserted] = positions.try_emplace(id, slots.size());
+  if (!inserted) {
+    auto& slot = slots[found->second];
+    slot.game = std::move(game);
+    slot.inbox.clear();
+    return;
+  }
+  slots.push_back(Slot{id, std::move(game), {}, {}});
+}
+
+
+void
+GameScheduler::removeGame(GameId id) {
+  auto found = positions.find(id);
+  if (positions.end() == found) {
+    return;
+  }
+
+  auto index = found->second;
+  positions.erase(found);
+  if (index + 1 != slots.size()) {
+    slots[index] = std::move(slots.back());
+    positions[slots[index].id] = index;
+  }
+  slots.pop_back();
+}
+
+
+bool
+GameScheduler::hasGame(GameId id) const {
+  return positions.count(id) != 0;
+}
+
+
+void
+GameScheduler::route(const std::vector<Message>& incoming,
+                     std::vector<Message>& unrouted) {
+  for (auto& message : incoming) {
+    auto room = rooms.getRoom(message.connection);
+    auto found = room ? positions.find(*room) : positions.end();
+    if (positions.end() == found) {
+      unrouted.push_back(message);
+    } else {
+      slots[found->second].inbox.push_back(copyMessage(message));
+    }
+  }
+}
+
+
+Message
+GameScheduler::copyMessage(const Message& message) {
+  if (spareTexts.empty()) {
+    return message;
+  }
+  Message copy{message.connection, std::move(spareTexts.back()), message.type};
+  spareTexts.pop_back();
+  copy.text.assign(message.text);
+  return copy;
+}
+
+
+void
+GameScheduler::tick(Outbox& outgoing) {
+  pool.parallelFor(slots.size(), [this] (std::size_t index) {
+    auto& slot = slots[index];
+    slot.game->tick(slot.inbox, slot.outbox);
+  });
+
+  for (auto& slot : slots) {
+    for (auto& message : slot.inbox) {
+      spareTexts.push_back(std::move(message.text));
+    }
+    slot.inbox.clear();
+    auto& [messages, broadcasts] = slot.outbox;
+    std::move(messages.begin(), messages.end(),
+              std::back_inserter(outgoing.messages));
+    std::move(broadcasts.begin(), broadcasts.end(),
+              std::back_inserter(outgoing.broadcasts));
+    slot.outbox.clear();
+  }
+}
+
@@ -0,0 +1,154 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <utility>
+
+using scheduling::WorkStealingPool;
+
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount) {
+  if (0 == threadCount) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  queues.reserve(threadCount);
+  for (unsigned i = 0; i < threadCount; ++i) {
+    queues.push_back(std::make_unique<TaskQueue>());
+  }
+
+  // The last queue belongs to whichever thread calls parallelFor.
+  workers.reserve(threadCount - 1);
+  for (unsigned i = 0; i + 1 < threadCount; ++i) {
+    workers.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard lock{batchLock};
+    stopping = true;
+  }
+  batchReady.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+
+void
+WorkStealingPool::parallelFor(std::size_t count,
+                              const std::function<void(std::size_t)>& task) {
+  if (0 == count) {
+    return;
+  }
+
+  currentTask = &task;
+  remaining = count;
+  for (std::size_t i = 0; i < count; ++i) {
+    auto& queue = *queues[i % queues.size()];
+    std::lock_guard lock{queue.lock};
+    queue.indices.push_back(i);
+  }
+
+  {
+    std::lock_guard lock{batchLock};
+    ++batch;
+  }
+  batchReady.notify_all();
+
+  auto self = queues.size() - 1;
+  while (runOne(self)) {
+  }
+
+  std::unique_lock lock{batchLock};
+  batchDone.wait(lock, [this] { return 0 == remaining; });
+  currentTask = nullptr;
+  if (failure) {
+    std::rethrow_exception(std::exchange(failure, nullptr));
+  }
+}
+
+
+void
+WorkStealingPool::workerLoop(std::size_t self) {
+  uint64_t seenBatch = 0;
+  while (true) {
+    {
+      std::unique_lock lock{batchLock};
+      batchReady.wait(lock, [this, seenBatch] {
+        return stopping || batch != seenBatch;
+      });
+      if (stopping) {
+        return;
+      }
+      seenBatch = batch;
+    }
+
+    while (runOne(self)) {
+    }
+  }
+}
+
+
+bool
+WorkStealingPool::runOne(std::size_t self) {
+  std::size_t index;
+  if (!popOwn(self, index) && !steal(self, index)) {
+    return false;
+  }
+
+  try {
+    (*currentTask)(index);
+  } catch (...) {
+    std::lock_guard lock{batchLock};
+    if (!failure) {
+      failure = std::current_exception();
+    }
+  }
+
+  if (1 == remaining.fetch_sub(1, std::memory_order_acq_rel)) {
+    // Taking the lock ensures the caller is either not yet waiting or will
+    // observe the notification.
+    std::lock_guard lock{batchLock};
+    batchDone.notify_all();
+  }
+  return true;
+}
+
+
+bool
+WorkStealingPool::popOwn(std::size_t self, std::size_t& index) {
+  auto& queue = *queues[self];
+  std::lock_guard lock{queue.lock};
+  if (queue.indices.empty()) {
+    return false;
+  }
+  index = queue.indices.front();
+  queue.indices.pop_front();
+  return true;
+}
+
+
+bool
+WorkStealingPool::steal(std::size_t self, std::size_t& index) {
+  for (std::size_t offset = 1; offset < queues.size(); ++offset) {
+    auto& queue = *queues[(self + offset) % queues.size()];
+    std::lock_guard lock{queue.lock};
+    if (!queue.indices.empty()) {
+      index = queue.indices.back();
+      queue.indices.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
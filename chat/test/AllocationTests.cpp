@@ -0,0 +1,249 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "Client.h"
+#include "GameScheduler.h"
+#include "RoomManager.h"
+#include "Server.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+
+using networking::Client;
+using networking::ClientContext;
+using networking::Connection;
+using networking::Message;
+using networking::RoomManager;
+using networking::ReceivedMessage;
+using networking::Server;
+using networking::ServerOptions;
+using networking::SharedText;
+using scheduling::GameScheduler;
+using scheduling::Outbox;
+
+
+namespace {
+
+std::atomic<bool> counting = false;
+std::atomic<std::size_t> allocations = 0;
+
+}
+
+
+void*
+operator new(std::size_t size) {
+  if (counting.load(std::memory_order_relaxed)) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void* memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  throw std::bad_alloc{};
+}
+
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+
+namespace {
+
+
+constexpr auto TIMEOUT = std::chrono::seconds{10};
+
+
+/**
+ *  A single threaded Server with a number of connected Clients. Each check
+ *  runs a few rounds first, so that buffers, queues, and handler memory have
+ *  all reached their steady state sizes before anything is counted.
+ */
+class AllocationTest : public ::testing::Test {
+protected:
+  static constexpr std::size_t CLIENTS = 10;
+  static constexpr int WARMUP_ROUNDS = 4;
+
+  explicit AllocationTest(unsigned short port = 4880,
+                          ServerOptions options = {})
+    : server{port, "", [this] (Connection c) { connections.push_back(c); },
+             [] (Connection) {}, options} {
+    auto portName = std::to_string(port);
+    for (std::size_t i = 0; i < CLIENTS; ++i) {
+      clients.push_back(std::make_unique<Client>(context, "localhost", portName));
+    }
+    auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    while (connections.size() < CLIENTS
+           && std::chrono::steady_clock::now() < deadline) {
+      server.update();
+      context.update();
+    }
+  }
+
+  template <typename Predicate>
+  bool
+  updateServerUntil(Predicate done) {
+    auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    while (!done()) {
+      if (deadline < std::chrono::steady_clock::now()) {
+        return false;
+      }
+      server.update();
+    }
+    return true;
+  }
+
+  void
+  drainClients() {
+    std::vector<ReceivedMessage> scratch;
+    for (int i = 0; i < 20; ++i) {
+      context.update();
+      for (auto& client : clients) {
+        client->receive(scratch);
+      }
+    }
+  }
+
+  // Returns the allocations made broadcasting one message and updating the
+  // Server until it has been written to every Client.
+  std::size_t
+  countBroadcast(SharedText text) {
+    std::size_t counted = 0;
+    for (int round = 0; round <= WARMUP_ROUNDS; ++round) {
+      auto target = server.getMetrics().messagesOut + connections.size();
+      allocations = 0;
+      counting = true;
+      server.broadcast(text, connections);
+      bool written = updateServerUntil([&] {
+        return target <= server.getMetrics().messagesOut;
+      });
+      counting = false;
+      counted = allocations;
+      EXPECT_TRUE(written);
+      drainClients();
+    }
+    return counted;
+  }
+
+  // Returns the allocations made updating the Server until one message from
+  // each Client has been read, receiving them, and then handing them to
+  // `consume`.
+  template <typename Consumer>
+  std::size_t
+  countReceive(Consumer consume) {
+    std::vector<Message> incoming;
+    std::size_t counted = 0;
+    for (int round = 0; round <= WARMUP_ROUNDS; ++round) {
+      auto target = server.getMetrics().messagesIn + clients.size();
+      for (auto& client : clients) {
+        client->send(std::string(128, 'y'));
+      }
+      for (int i = 0; i < 20; ++i) {
+        context.update();
+      }
+      allocations = 0;
+      counting = true;
+      bool read = updateServerUntil([&] {
+        return target <= server.getMetrics().messagesIn;
+      });
+      server.receive(incoming);
+      EXPECT_EQ(clients.size(), incoming.size());
+      consume(incoming);
+      counting = false;
+      counted = allocations;
+      EXPECT_TRUE(read);
+    }
+    return counted;
+  }
+
+  std::vector<Connection> connections;
+  Server server;
+  ClientContext context;
+  std::vector<std::unique_ptr<Client>> clients;
+};
+
+
+/** The same checks with one background thread running all of the I/O. */
+class SingleIOThreadAllocationTest : public AllocationTest {
+protected:
+  SingleIOThreadAllocationTest()
+    : AllocationTest{4881, withIOThreads(1)}
+      { }
+
+  static ServerOptions
+  withIOThreads(unsigned threads) {
+    ServerOptions options;
+    options.ioThreads = threads;
+    return options;
+  }
+};
+
+
+TEST_F(AllocationTest, broadcastAllocatesOncePerRecipient) {
+  ASSERT_EQ(CLIENTS, connections.size());
+  auto text = std::make_shared<const std::string>(128, 'x');
+  // The text is queued for every Channel directly, and executor copies,
+  // handler state, and gathered buffers must not allocate for each write.
+  // Only the websocket write operations themselves are left, since more of
+  // them are in flight than Asio caches.
+  EXPECT_LE(countBroadcast(text), CLIENTS);
+}
+
+
+TEST_F(SingleIOThreadAllocationTest, broadcastPostsOnceForAllRecipients) {
+  ASSERT_EQ(CLIENTS, connections.size());
+  auto text = std::make_shared<const std::string>(128, 'x');
+  // Beyond the writes, only the recipient list and one handler allocate.
+  EXPECT_LE(countBroadcast(text), CLIENTS + 2);
+}
+
+
+TEST_F(AllocationTest, steadyStateReceiveDoesNotAllocatePerMessage) {
+  ASSERT_EQ(CLIENTS, connections.size());
+  EXPECT_LT(countReceive([] (auto& /*incoming*/) {}), CLIENTS);
+}
+
+
+class SilentGame final : public scheduling::Game {
+public:
+  void tick(const std::vector<Message>& /*inbox*/, Outbox& /*outbox*/) override {}
+};
+
+
+TEST_F(AllocationTest, routingLeavesReceivedTextsForReuse) {
+  ASSERT_EQ(CLIENTS, connections.size());
+  constexpr networking::RoomId ROOM = 1;
+  RoomManager rooms;
+  for (auto connection : connections) {
+    rooms.join(connection, ROOM);
+  }
+  GameScheduler scheduler{rooms, 1};
+  scheduler.addGame(ROOM, std::make_unique<SilentGame>());
+  std::vector<Message> unrouted;
+  Outbox outbox;
+
+  // Routing must copy into storage recycled from earlier ticks rather than
+  // take the texts that Server::receive() recycles.
+  auto counted = countReceive([&] (auto& incoming) {
+    scheduler.route(incoming, unrouted);
+    EXPECT_EQ(clients.size(), incoming.size());
+    EXPECT_TRUE(unrouted.empty());
+    scheduler.tick(outbox);
+    outbox.clear();
+  });
+  EXPECT_LT(counted, CLIENTS);
+}
+
+
+}
@@ -0,0 +1,130 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "AssetCache.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+
+using networking::Asset;
+using networking::AssetVariant;
+using networking::matchesETag;
+
+
+namespace {
+
+
+AssetVariant
+makeVariant(std::size_t size, std::string etag) {
+  return {std::make_shared<const std::string>(size, 'x'), std::move(etag)};
+}
+
+
+// Brotli is the smallest variant and identity the largest, as they would be
+// for most text.
+Asset
+makeAsset() {
+  return {"text/plain",
+          makeVariant(300, "\"identity\""),
+          makeVariant(200, "\"gzip\""),
+          makeVariant(100, "\"brotli\"")};
+}
+
+
+std::string_view
+selectEncoding(const Asset& asset, std::string_view acceptEncoding) {
+  return asset.selectVariant(acceptEncoding).second;
+}
+
+
+TEST(AssetTest, selectsTheSmallestAcceptableVariant) {
+  auto asset = makeAsset();
+  auto [variant, encoding] = asset.selectVariant("gzip, deflate, br");
+  EXPECT_EQ("br", encoding);
+  EXPECT_EQ(&asset.brotli, variant);
+  EXPECT_EQ("gzip", selectEncoding(asset, "gzip"));
+
+  // A smaller gzip variant wins over brotli.
+  asset.gzip = makeVariant(50, "\"gzip\"");
+  EXPECT_EQ("gzip", selectEncoding(asset, "br, gzip"));
+}
+
+
+TEST(AssetTest, fallsBackToIdentity) {
+  auto asset = makeAsset();
+  auto [variant, encoding] = asset.selectVariant("");
+  EXPECT_EQ("", encoding);
+  EXPECT_EQ(&asset.identity, variant);
+  EXPECT_EQ("", selectEncoding(asset, "deflate, compress"));
+
+  // Missing variants are never selected, even when accepted.
+  Asset plain{"text/plain", makeVariant(300, "\"identity\""), {}, {}};
+  EXPECT_EQ("", selectEncoding(plain, "gzip, br"));
+}
+
+
+TEST(AssetTest, zeroQualityExcludesAnEncoding) {
+  auto asset = makeAsset();
+  EXPECT_EQ("gzip", selectEncoding(asset, "gzip, br;q=0"));
+  EXPECT_EQ("gzip", selectEncoding(asset, "gzip;q=0.5, br; Q=0.000"));
+  EXPECT_EQ("br", selectEncoding(asset, "gzip;q=0, br;q=0.001"));
+  EXPECT_EQ("", selectEncoding(asset, "gzip;q=0, br;q=0"));
+}
+
+
+TEST(AssetTest, wildcardCoversUnlistedEncodings) {
+  auto asset = makeAsset();
+  EXPECT_EQ("br", selectEncoding(asset, "*"));
+  EXPECT_EQ("gzip", selectEncoding(asset, "gzip, *;q=0"));
+  // An explicit entry takes precedence over the wildcard in either order.
+  EXPECT_EQ("gzip", selectEncoding(asset, "br;q=0, *"));
+  EXPECT_EQ("gzip", selectEncoding(asset, "*, br;q=0"));
+  EXPECT_EQ("", selectEncoding(asset, "*;q=0"));
+}
+
+
+TEST(ETagTest, matchesAnyTagInTheList) {
+  EXPECT_TRUE(matchesETag("\"abc\"", "\"abc\""));
+  EXPECT_TRUE(matchesETag("\"one\", \"abc\"", "\"abc\""));
+  EXPECT_TRUE(matchesETag("\"one\",\"two\" ,\t\"abc\"", "\"abc\""));
+  EXPECT_FALSE(matchesETag("\"one\", \"two\"", "\"abc\""));
+  EXPECT_FALSE(matchesETag("", "\"abc\""));
+  EXPECT_FALSE(matchesETag("\"ab\"", "\"abc\""));
+}
+
+
+TEST(ETagTest, comparesWeakly) {
+  EXPECT_TRUE(matchesETag("W/\"abc\"", "\"abc\""));
+  EXPECT_TRUE(matchesETag("\"one\", W/\"abc\"", "\"abc\""));
+  EXPECT_TRUE(matchesETag("\"abc\"", "W/\"abc\""));
+}
+
+
+TEST(ETagTest, wildcardMatchesEverything) {
+  EXPECT_TRUE(matchesETag("*", "\"abc\""));
+  EXPECT_TRUE(matchesETag(" * ", "\"abc\""));
+}
+
+
+TEST(ETagTest, commasInsideTagsDoNotSplitThem) {
+  EXPECT_TRUE(matchesETag("\"a,b\"", "\"a,b\""));
+  EXPECT_FALSE(matchesETag("\"a,b\"", "\"b\""));
+}
+
+
+TEST(ETagTest, malformedListsDoNotMatch) {
+  EXPECT_FALSE(matchesETag("abc", "\"abc\""));
+  EXPECT_FALSE(matchesETag("\"abc", "\"abc\""));
+  EXPECT_FALSE(matchesETag("bad, \"abc\"", "\"abc\""));
+}
+
+
+}
@@ -0,0 +1,151 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "Overflow.h"
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+
+using networking::MessageType;
+using networking::Outgoing;
+using networking::OverflowPolicy;
+using networking::QueueDepth;
+using networking::QueueLimits;
+using networking::planOverflow;
+
+
+namespace {
+
+
+// A queue of `count` messages of `size` bytes each.
+std::deque<Outgoing>
+makeQueue(std::size_t count, std::size_t size = 10) {
+  std::deque<Outgoing> queue;
+  for (std::size_t i = 0; i < count; ++i) {
+    queue.push_back({std::make_shared<const std::string>(size, 'x'), MessageType::TEXT});
+  }
+  return queue;
+}
+
+
+QueueDepth
+getDepth(const std::deque<Outgoing>& queue) {
+  QueueDepth depth;
+  for (auto& outgoing : queue) {
+    depth.messages += 1;
+    depth.bytes += outgoing.text->size();
+  }
+  return depth;
+}
+
+
+QueueLimits
+messageLimits(std::size_t high, std::size_t low = 0) {
+  QueueLimits limits;
+  limits.highWaterMessages = high;
+  limits.lowWaterMessages = low;
+  return limits;
+}
+
+
+TEST(OverflowTest, nothingHappensAtOrBelowTheHighWatermark) {
+  auto queue = makeQueue(4);
+  for (auto policy : {OverflowPolicy::DROP_OLDEST,
+                      OverflowPolicy::KEEP_LATEST,
+                      OverflowPolicy::DISCONNECT}) {
+    auto action = planOverflow(queue, 0, getDepth(queue), messageLimits(4), policy);
+    EXPECT_FALSE(action.disconnect);
+    EXPECT_EQ(action.dropBegin, action.dropEnd);
+  }
+}
+
+
+TEST(OverflowTest, unlimitedQueuesNeverOverflow) {
+  auto queue = makeQueue(10'000);
+  auto action = planOverflow(queue, 0, getDepth(queue), QueueLimits{},
+                             OverflowPolicy::DISCONNECT);
+  EXPECT_FALSE(action.disconnect);
+}
+
+
+TEST(OverflowTest, disconnectPolicyDisconnects) {
+  auto queue = makeQueue(5);
+  auto action = planOverflow(queue, 1, getDepth(queue), messageLimits(4),
+                             OverflowPolicy::DISCONNECT);
+  EXPECT_TRUE(action.disconnect);
+}
+
+
+TEST(OverflowTest, dropOldestShrinksToTheLowWatermark) {
+  auto queue = makeQueue(9);
+  auto action = planOverflow(queue, 0, getDepth(queue), messageLimits(8, 4),
+                             OverflowPolicy::DROP_OLDEST);
+  EXPECT_FALSE(action.disconnect);
+  EXPECT_EQ(0u, action.dropBegin);
+  EXPECT_EQ(5u, action.dropEnd);
+}
+
+
+TEST(OverflowTest, dropOldestDefaultsTheLowWatermarkToTheHighOne) {
+  auto queue = makeQueue(9);
+  auto action = planOverflow(queue, 0, getDepth(queue), messageLimits(8),
+                             OverflowPolicy::DROP_OLDEST);
+  EXPECT_EQ(0u, action.dropBegin);
+  EXPECT_EQ(1u, action.dropEnd);
+}
+
+
+TEST(OverflowTest, dropOldestSparesMessagesInFlight) {
+  auto queue = makeQueue(9);
+  auto action = planOverflow(queue, 3, getDepth(queue), messageLimits(8, 2),
+                             OverflowPolicy::DROP_OLDEST);
+  // Only the 5 queued messages behind the write may go, and the newest
+  // always stays.
+  EXPECT_EQ(3u, action.dropBegin);
+  EXPECT_EQ(8u, action.dropEnd);
+}
+
+
+TEST(OverflowTest, dropOldestHonoursByteWatermarks) {
+  auto queue = makeQueue(6, 100);
+  QueueLimits limits;
+  limits.highWaterBytes = 500;
+  limits.lowWaterBytes = 250;
+  auto action = planOverflow(queue, 0, getDepth(queue), limits,
+                             OverflowPolicy::DROP_OLDEST);
+  // 600 bytes must come down to at most 250.
+  EXPECT_EQ(0u, action.dropBegin);
+  EXPECT_EQ(4u, action.dropEnd);
+}
+
+
+TEST(OverflowTest, keepLatestDropsAllButTheNewest) {
+  auto queue = makeQueue(9);
+  auto action = planOverflow(queue, 2, getDepth(queue), messageLimits(8, 4),
+                             OverflowPolicy::KEEP_LATEST);
+  EXPECT_FALSE(action.disconnect);
+  EXPECT_EQ(2u, action.dropBegin);
+  EXPECT_EQ(8u, action.dropEnd);
+}
+
+
+TEST(OverflowTest, nothingIsDroppableWhenEverythingElseIsInFlight) {
+  auto queue = makeQueue(3);
+  for (auto policy : {OverflowPolicy::DROP_OLDEST, OverflowPolicy::KEEP_LATEST}) {
+    auto action = planOverflow(queue, 2, getDepth(queue), messageLimits(1), policy);
+    EXPECT_FALSE(action.disconnect);
+    EXPECT_EQ(action.dropBegin, action.dropEnd);
+  }
+}
+
+
+}
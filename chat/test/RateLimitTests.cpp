@@ -0,0 +1,172 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "FloodGuard.h"
+#include "TokenBucket.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+
+using networking::FloodGuard;
+using networking::FloodPolicy;
+using networking::RateLimits;
+using networking::TokenBucket;
+
+
+namespace {
+
+
+using std::chrono::milliseconds;
+using Verdict = FloodGuard::Verdict;
+
+
+// Every test drives time by hand, so nothing ever sleeps.
+constexpr TokenBucket::Clock::time_point START{};
+
+
+TokenBucket::Clock::time_point
+at(int ms) {
+  return START + milliseconds{ms};
+}
+
+
+TEST(TokenBucketTest, startsFullAndAllowsABurstUpToItsCapacity) {
+  TokenBucket bucket{10, 3, START};
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(bucket.canTake(1));
+    bucket.take(1);
+  }
+  EXPECT_FALSE(bucket.canTake(1));
+}
+
+
+TEST(TokenBucketTest, refillsAtItsRate) {
+  TokenBucket bucket{10, 5, START};
+  bucket.take(5);
+  bucket.refill(at(99));
+  EXPECT_FALSE(bucket.canTake(1));
+  bucket.refill(at(100));
+  EXPECT_TRUE(bucket.canTake(1));
+  EXPECT_FALSE(bucket.canTake(2));
+  bucket.refill(at(300));
+  EXPECT_TRUE(bucket.canTake(3));
+  EXPECT_FALSE(bucket.canTake(4));
+}
+
+
+TEST(TokenBucketTest, neverRefillsPastItsCapacity) {
+  TokenBucket bucket{10, 2, START};
+  bucket.refill(at(60'000));
+  bucket.take(2);
+  EXPECT_FALSE(bucket.canTake(1));
+}
+
+
+TEST(TokenBucketTest, defaultsToOneSecondOfBurst) {
+  TokenBucket bucket{4, 0, START};
+  bucket.take(4);
+  EXPECT_FALSE(bucket.canTake(1));
+
+  TokenBucket slow{0.5, 0, START};
+  EXPECT_TRUE(slow.canTake(1));
+}
+
+
+TEST(TokenBucketTest, amountsBeyondTheCapacityNeedOnlyAFullBucket) {
+  TokenBucket bucket{100, 10, START};
+  EXPECT_TRUE(bucket.canTake(50));
+  bucket.take(1);
+  EXPECT_FALSE(bucket.canTake(50));
+}
+
+
+TEST(TokenBucketTest, debtIsRepaidBeforeTokensReturn) {
+  TokenBucket bucket{10, 1, START};
+  bucket.take(3);
+  EXPECT_EQ(milliseconds{200}, bucket.getDebtDuration());
+  bucket.refill(at(150));
+  EXPECT_FALSE(bucket.canTake(1));
+  EXPECT_EQ(milliseconds{50}, bucket.getDebtDuration());
+  bucket.refill(at(300));
+  EXPECT_EQ(TokenBucket::Clock::duration::zero(), bucket.getDebtDuration());
+  EXPECT_TRUE(bucket.canTake(1));
+}
+
+
+TEST(TokenBucketTest, zeroRateIsUnlimited) {
+  TokenBucket bucket{0, 0, START};
+  bucket.take(1'000'000);
+  EXPECT_TRUE(bucket.canTake(1'000'000));
+  EXPECT_EQ(TokenBucket::Clock::duration::zero(), bucket.getDebtDuration());
+}
+
+
+RateLimits
+messagesPerSecond(double rate, std::size_t burst) {
+  RateLimits limits;
+  limits.messagesPerSecond = rate;
+  limits.burstMessages = burst;
+  return limits;
+}
+
+
+TEST(FloodGuardTest, acceptsEverythingWithoutLimits) {
+  FloodGuard guard{RateLimits{}, FloodPolicy::DISCONNECT, START};
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(Verdict::ACCEPT, guard.admit(1'000'000, START));
+  }
+  EXPECT_EQ(TokenBucket::Clock::duration::zero(), guard.getPause());
+}
+
+
+TEST(FloodGuardTest, dropRejectsUntilTheBucketRefills) {
+  FloodGuard guard{messagesPerSecond(10, 2), FloodPolicy::DROP, START};
+  EXPECT_EQ(Verdict::ACCEPT, guard.admit(1, START));
+  EXPECT_EQ(Verdict::ACCEPT, guard.admit(1, START));
+  EXPECT_EQ(Verdict::REJECT, guard.admit(1, START));
+  EXPECT_EQ(Verdict::REJECT, guard.admit(1, at(99)));
+  EXPECT_EQ(Verdict::ACCEPT, guard.admit(1, at(100)));
+  // Rejected messages cost nothing, so reading never pauses.
+  EXPECT_EQ(TokenBucket::Clock::duration::zero(), guard.getPause());
+}
+
+
+TEST(FloodGuardTest, disconnectOnceOverTheLimit) {
+  FloodGuard guard{messagesPerSecond(10, 1), FloodPolicy::DISCONNECT, START};
+  EXPECT_EQ(Verdict::ACCEPT, guard.admit(1, START));
+  EXPECT_EQ(Verdict::DISCONNECT, guard.admit(1, at(50)));
+}
+
+
+TEST(FloodGuardTest, throttleAcceptsAndPausesReading) {
+  FloodGuard guard{messagesPerSecond(10, 2), FloodPolicy::THROTTLE, START};
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(Verdict::ACCEPT, guard.admit(1, START));
+  }
+  // Three messages of debt at ten per second.
+  EXPECT_EQ(milliseconds{300}, guard.getPause());
+  EXPECT_EQ(Verdict::ACCEPT, guard.admit(1, at(300)));
+  EXPECT_EQ(milliseconds{100}, guard.getPause());
+}
+
+
+TEST(FloodGuardTest, byteLimitAppliesIndependently) {
+  RateLimits limits;
+  limits.bytesPerSecond = 1000;
+  limits.burstBytes = 1500;
+  FloodGuard guard{limits, FloodPolicy::DROP, START};
+  EXPECT_EQ(Verdict::ACCEPT, guard.admit(1000, START));
+  EXPECT_EQ(Verdict::REJECT, guard.admit(1000, START));
+  EXPECT_EQ(Verdict::ACCEPT, guard.admit(500, START));
+  EXPECT_EQ(Verdict::ACCEPT, guard.admit(1000, at(1000)));
+}
+
+
+}
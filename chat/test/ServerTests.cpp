@@ -0,0 +1,167 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "Client.h"
+#include "Server.h"
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using networking::Client;
+using networking::Connection;
+using networking::Server;
+using networking::ServerOptions;
+
+
+namespace {
+
+
+/**
+ *  A Server that is only ever updated with a long timeout and a Client that
+ *  is driven from a thread of its own, so that any wait that misses a
+ *  connection event shows up as the whole timeout passing. The parameter is
+ *  ServerOptions::ioThreads.
+ */
+class UpdateWakeTest : public ::testing::TestWithParam<unsigned> {
+protected:
+  static constexpr auto TIMEOUT = std::chrono::seconds{10};
+  static constexpr auto PROMPTLY = std::chrono::seconds{5};
+
+  UpdateWakeTest()
+    : port{static_cast<unsigned short>(4892 + GetParam())},
+      server{port, "",
+             [this] (Connection c) { connects.push_back(c); },
+             [this] (Connection c) { disconnects.push_back(c); },
+             withIOThreads(GetParam())}
+      { }
+
+  ~UpdateWakeTest() override {
+    closeClient();
+  }
+
+  static ServerOptions
+  withIOThreads(unsigned ioThreads) {
+    ServerOptions options;
+    options.ioThreads = ioThreads;
+    return options;
+  }
+
+  void
+  openClient() {
+    clientThread.emplace([this] {
+      Client client{"localhost", std::to_string(port)};
+      while (!stopClient) {
+        client.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      }
+    });
+  }
+
+  void
+  closeClient() {
+    stopClient = true;
+    if (clientThread) {
+      clientThread->join();
+      clientThread.reset();
+    }
+  }
+
+  // Updates until the predicate holds, returning how long it took.
+  template <typename Predicate>
+  std::chrono::steady_clock::duration
+  updateUntil(Predicate done) {
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + 3 * TIMEOUT;
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+      server.updateFor(TIMEOUT);
+    }
+    return std::chrono::steady_clock::now() - start;
+  }
+
+  unsigned short port;
+  std::vector<Connection> connects;
+  std::vector<Connection> disconnects;
+  Server server;
+  std::atomic<bool> stopClient = false;
+  std::optional<std::thread> clientThread;
+};
+
+
+TEST_P(UpdateWakeTest, wakesWhenAClientConnects) {
+  openClient();
+  auto elapsed = updateUntil([this] { return !connects.empty(); });
+  EXPECT_EQ(1u, connects.size());
+  EXPECT_LT(elapsed, PROMPTLY);
+}
+
+
+TEST_P(UpdateWakeTest, wakesWhenAClientDisconnects) {
+  openClient();
+  ASSERT_LT(updateUntil([this] { return !connects.empty(); }), PROMPTLY);
+
+  closeClient();
+  auto elapsed = updateUntil([this] { return !disconnects.empty(); });
+  ASSERT_EQ(1u, disconnects.size());
+  EXPECT_EQ(connects.front(), disconnects.front());
+  EXPECT_LT(elapsed, PROMPTLY);
+}
+
+
+INSTANTIATE_TEST_SUITE_P(IOThreads, UpdateWakeTest, ::testing::Values(0u, 1u));
+
+
+// Makes a single HTTP GET request and returns the response.
+boost::beast::http::response<boost::beast::http::string_body>
+get(unsigned short port, std::string target) {
+  boost::asio::io_context ioContext;
+  boost::asio::ip::tcp::resolver resolver{ioContext};
+  boost::asio::ip::tcp::socket socket{ioContext};
+  boost::asio::connect(socket, resolver.resolve("localhost", std::to_string(port)));
+
+  namespace http = boost::beast::http;
+  http::request<http::empty_body> request{http::verb::get, target, 11};
+  request.set(http::field::host, "localhost");
+  http::write(socket, request);
+
+  boost::beast::flat_buffer buffer;
+  http::response<http::string_body> response;
+  http::read(socket, buffer, response);
+  return response;
+}
+
+
+TEST(HTTPTest, metricsIgnoreTheQueryString) {
+  constexpr unsigned short PORT = 4894;
+  ServerOptions options;
+  // The I/O thread answers HTTP requests without the Server being updated.
+  options.ioThreads = 1;
+  options.serveMetrics = true;
+  Server server{PORT, "<html></html>", [] (Connection) {}, [] (Connection) {}, options};
+
+  auto plain = get(PORT, "/metrics");
+  EXPECT_EQ(boost::beast::http::status::ok, plain.result());
+  auto queried = get(PORT, "/metrics?name[]=connections");
+  EXPECT_EQ(boost::beast::http::status::ok, queried.result());
+  EXPECT_EQ(plain[boost::beast::http::field::content_type],
+            queried[boost::beast::http::field::content_type]);
+  EXPECT_FALSE(queried.body().empty());
+}
+
+
+}
@@ -0,0 +1,286 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "Client.h"
+#include "Server.h"
+#include "Session.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+using networking::Channel;
+using networking::Client;
+using networking::Connection;
+using networking::Message;
+using networking::MessageType;
+using networking::Outgoing;
+using networking::ReceivedMessage;
+using networking::Server;
+using networking::ServerOptions;
+using networking::Session;
+
+
+namespace {
+
+
+Outgoing
+makeOutgoing(std::string text) {
+  return {std::make_shared<const std::string>(std::move(text)), MessageType::TEXT};
+}
+
+
+std::vector<std::string>
+getTexts(const std::deque<Outgoing>& messages) {
+  std::vector<std::string> texts;
+  for (auto& message : messages) {
+    texts.push_back(*message.text);
+  }
+  return texts;
+}
+
+
+// A stand in for an attached Channel. Sessions only ever hold weak pointers
+// to their Channels, so an owner without a Channel behind it is enough.
+std::shared_ptr<Channel>
+makeAttachedChannel() {
+  return {static_cast<Channel*>(nullptr), [] (Channel*) {}};
+}
+
+
+// Opens a Session and records the given messages as written.
+void
+openAndWrite(Session& session, std::shared_ptr<Channel>& channel, int count) {
+  channel = makeAttachedChannel();
+  session.open(Connection{7}, channel);
+  for (int i = 0; i < count; ++i) {
+    session.recordWritten(makeOutgoing(std::to_string(i)));
+  }
+}
+
+
+TEST(SessionTest, cannotResumeWhileAttached) {
+  Session session{"token", 4};
+  std::shared_ptr<Channel> channel;
+  openAndWrite(session, channel, 2);
+  auto next = makeAttachedChannel();
+  EXPECT_FALSE(session.resume(next, 0));
+}
+
+
+TEST(SessionTest, replaysTheMessagesAClientMissed) {
+  Session session{"token", 4};
+  std::shared_ptr<Channel> channel;
+  openAndWrite(session, channel, 3);
+  std::deque<Outgoing> unwritten;
+  session.detach(unwritten.begin(), unwritten.end());
+  channel.reset();
+
+  auto next = makeAttachedChannel();
+  auto missed = session.resume(next, 1);
+  ASSERT_TRUE(missed);
+  EXPECT_EQ((std::vector<std::string>{"1", "2"}), getTexts(*missed));
+  EXPECT_EQ(Connection{7}, session.getConnection());
+}
+
+
+TEST(SessionTest, replayRingOnlyHoldsTheMostRecentMessages) {
+  Session session{"token", 4};
+  std::shared_ptr<Channel> channel;
+  openAndWrite(session, channel, 10);
+  std::deque<Outgoing> unwritten;
+  session.detach(unwritten.begin(), unwritten.end());
+  channel.reset();
+
+  // Messages 0 through 5 have left the ring, so a Client that received
+  // fewer than 6 cannot catch up.
+  auto next = makeAttachedChannel();
+  EXPECT_FALSE(session.resume(next, 5));
+  // More than was ever written is not a valid count either.
+  EXPECT_FALSE(session.resume(next, 11));
+  auto missed = session.resume(next, 6);
+  ASSERT_TRUE(missed);
+  EXPECT_EQ((std::vector<std::string>{"6", "7", "8", "9"}), getTexts(*missed));
+}
+
+
+TEST(SessionTest, parkedMessagesFollowTheReplayedOnes) {
+  Session session{"token", 3};
+  std::shared_ptr<Channel> channel;
+  openAndWrite(session, channel, 2);
+  std::deque<Outgoing> unwritten{makeOutgoing("u")};
+  session.detach(unwritten.begin(), unwritten.end());
+  channel.reset();
+
+  for (auto text : {"p1", "p2", "p3"}) {
+    EXPECT_EQ(nullptr, session.parkOrForward(makeOutgoing(text)));
+  }
+
+  // Parking is bounded by the same capacity as the ring, dropping the
+  // oldest.
+  auto next = makeAttachedChannel();
+  auto missed = session.resume(next, 1);
+  ASSERT_TRUE(missed);
+  EXPECT_EQ((std::vector<std::string>{"1", "p1", "p2", "p3"}), getTexts(*missed));
+
+  // Once attached again, messages go to the new Channel.
+  EXPECT_EQ(next, session.parkOrForward(makeOutgoing("later")));
+}
+
+
+TEST(SessionTest, expiresOnlyFromTheLatestDetachment) {
+  Session session{"token", 4};
+  std::shared_ptr<Channel> channel;
+  openAndWrite(session, channel, 1);
+  std::deque<Outgoing> unwritten;
+  auto first = session.detach(unwritten.begin(), unwritten.end());
+  channel.reset();
+
+  // A resume makes the timer of the earlier detachment stale.
+  auto next = makeAttachedChannel();
+  ASSERT_TRUE(session.resume(next, 1));
+  auto second = session.detach(unwritten.begin(), unwritten.end());
+  next.reset();
+  EXPECT_FALSE(session.expire(first));
+  EXPECT_TRUE(session.expire(second));
+
+  auto late = makeAttachedChannel();
+  EXPECT_FALSE(session.resume(late, 1));
+  EXPECT_FALSE(session.expire(second));
+}
+
+
+TEST(SessionTest, endedSessionsCannotResume) {
+  Session session{"token", 4};
+  std::shared_ptr<Channel> channel;
+  openAndWrite(session, channel, 1);
+  std::deque<Outgoing> unwritten;
+  session.detach(unwritten.begin(), unwritten.end());
+  channel.reset();
+  session.end();
+
+  auto next = makeAttachedChannel();
+  EXPECT_FALSE(session.resume(next, 1));
+  EXPECT_EQ(nullptr, session.parkOrForward(makeOutgoing("dropped")));
+}
+
+
+/**
+ *  A Server with sessions enabled and one Client, both driven from the test
+ *  thread.
+ */
+class SessionResumeTest : public ::testing::Test {
+protected:
+  static constexpr auto TIMEOUT = std::chrono::seconds{10};
+
+  explicit SessionResumeTest(unsigned short port = 4890,
+                             std::chrono::milliseconds retention = std::chrono::seconds{30})
+    : server{port, "",
+             [this] (Connection c) { connects.push_back(c); },
+             [this] (Connection c) { disconnects.push_back(c); },
+             withSessions(retention)},
+      client{"localhost", std::to_string(port)} {
+    updateUntil([this] { return !connects.empty(); });
+  }
+
+  static ServerOptions
+  withSessions(std::chrono::milliseconds retention) {
+    ServerOptions options;
+    options.sessions.enabled = true;
+    options.sessions.retention = retention;
+    return options;
+  }
+
+  template <typename Predicate>
+  bool
+  updateUntil(Predicate done, bool updateClient = true) {
+    auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    while (!done()) {
+      if (deadline < std::chrono::steady_clock::now()) {
+        return false;
+      }
+      server.update();
+      if (updateClient) {
+        client.update();
+        std::vector<ReceivedMessage> messages;
+        client.receive(messages);
+        for (auto& message : messages) {
+          received.push_back(message.text);
+        }
+      }
+    }
+    return true;
+  }
+
+  void
+  send(std::string text) {
+    server.send({Message{connects.front(), std::move(text)}});
+  }
+
+  // Gives the Server time to see the old connection fail without letting
+  // the Client reconnect yet.
+  void
+  updateServerFor(std::chrono::milliseconds duration) {
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    updateUntil([deadline] { return deadline < std::chrono::steady_clock::now(); },
+                false);
+  }
+
+  std::vector<Connection> connects;
+  std::vector<Connection> disconnects;
+  std::vector<std::string> received;
+  Server server;
+  Client client;
+};
+
+
+TEST_F(SessionResumeTest, resumesTheSameConnectionAndReplaysMissedMessages) {
+  ASSERT_EQ(1u, connects.size());
+  send("one");
+  ASSERT_TRUE(updateUntil([this] { return received.size() == 1; }));
+  EXPECT_FALSE(client.wasResumed());
+
+  client.reconnect();
+  updateServerFor(std::chrono::milliseconds{50});
+  send("two");
+  send("three");
+  ASSERT_TRUE(updateUntil([this] { return received.size() == 3; }));
+
+  EXPECT_TRUE(client.wasResumed());
+  EXPECT_EQ((std::vector<std::string>{"one", "two", "three"}), received);
+  EXPECT_EQ(1u, connects.size());
+  EXPECT_TRUE(disconnects.empty());
+}
+
+
+class ExpiringSessionResumeTest : public SessionResumeTest {
+protected:
+  ExpiringSessionResumeTest()
+    : SessionResumeTest{4891, std::chrono::milliseconds{20}}
+      { }
+};
+
+
+TEST_F(ExpiringSessionResumeTest, expiredSessionsStartOverWithANewToken) {
+  ASSERT_EQ(1u, connects.size());
+  client.reconnect();
+  ASSERT_TRUE(updateUntil([this] { return !disconnects.empty(); }, false));
+  EXPECT_EQ(connects.front(), disconnects.front());
+
+  ASSERT_TRUE(updateUntil([this] { return connects.size() == 2; }));
+  EXPECT_FALSE(client.wasResumed());
+  EXPECT_FALSE(connects.front() == connects.back());
+}
+
+
+}
@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "SlotMap.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+
+
+using networking::SlotMap;
+
+
+namespace {
+
+
+uint64_t
+getGeneration(uint64_t key) {
+  return key >> 32;
+}
+
+
+uint32_t
+getIndex(uint64_t key) {
+  return static_cast<uint32_t>(key);
+}
+
+
+TEST(SlotMapTest, findsInsertedValues) {
+  SlotMap<std::string> map;
+  auto first = map.insert("first");
+  auto second = map.insert("second");
+  EXPECT_NE(0u, first);
+  EXPECT_NE(first, second);
+  ASSERT_TRUE(map.find(first));
+  ASSERT_TRUE(map.find(second));
+  EXPECT_EQ("first", *map.find(first));
+  EXPECT_EQ("second", *map.find(second));
+  EXPECT_EQ(2u, map.size());
+}
+
+
+TEST(SlotMapTest, staleKeyMissesAfterItsSlotIsReused) {
+  SlotMap<std::string> map;
+  auto stale = map.insert("old");
+  EXPECT_TRUE(map.erase(stale));
+  auto fresh = map.insert("new");
+
+  EXPECT_EQ(getIndex(stale), getIndex(fresh));
+  EXPECT_NE(getGeneration(stale), getGeneration(fresh));
+  EXPECT_EQ(nullptr, map.find(stale));
+  EXPECT_FALSE(map.erase(stale));
+  ASSERT_TRUE(map.find(fresh));
+  EXPECT_EQ("new", *map.find(fresh));
+  EXPECT_EQ(1u, map.size());
+}
+
+
+TEST(SlotMapTest, findReturnsNullForAFreedSlot) {
+  SlotMap<int> map;
+  auto kept = map.insert(1);
+  auto freed = map.insert(2);
+  EXPECT_TRUE(map.erase(freed));
+  EXPECT_EQ(nullptr, map.find(freed));
+
+  // Even a key carrying the freed slot's current generation must miss, since
+  // no value owns the slot.
+  auto forged = ((getGeneration(freed) + 1) << 32) | getIndex(freed);
+  EXPECT_EQ(nullptr, map.find(forged));
+  EXPECT_EQ(nullptr, map.find(0));
+  EXPECT_EQ(nullptr, map.find(uint64_t{1} << 32 | 1000));
+
+  ASSERT_TRUE(map.find(kept));
+  EXPECT_EQ(1, *map.find(kept));
+}
+
+
+TEST(SlotMapTest, erasingKeepsOtherKeysValid) {
+  SlotMap<int> map;
+  auto a = map.insert(1);
+  auto b = map.insert(2);
+  auto c = map.insert(3);
+  // Erasing from the front moves the last value into the hole.
+  EXPECT_TRUE(map.erase(a));
+  ASSERT_TRUE(map.find(b));
+  ASSERT_TRUE(map.find(c));
+  EXPECT_EQ(2, *map.find(b));
+  EXPECT_EQ(3, *map.find(c));
+
+  int sum = 0;
+  for (int value : map) {
+    sum += value;
+  }
+  EXPECT_EQ(5, sum);
+}
+
+
+TEST(SlotMapTest, generationWrapsAroundSkippingZero) {
+  SlotMap<int, uint8_t> map;
+  auto first = map.insert(0);
+  EXPECT_EQ(1u, getGeneration(first));
+
+  auto previous = first;
+  EXPECT_TRUE(map.erase(previous));
+  for (int reuse = 1; reuse < 255; ++reuse) {
+    auto key = map.insert(reuse);
+    EXPECT_EQ(getIndex(first), getIndex(key));
+    EXPECT_NE(0u, getGeneration(key));
+    EXPECT_EQ(nullptr, map.find(previous));
+    EXPECT_TRUE(map.erase(key));
+    previous = key;
+  }
+  EXPECT_EQ(255u, getGeneration(previous));
+
+  // After generation 255 comes 1 rather than 0, so the key is never 0.
+  auto wrapped = map.insert(255);
+  EXPECT_EQ(1u, getGeneration(wrapped));
+  EXPECT_NE(0u, wrapped);
+  EXPECT_EQ(nullptr, map.find(previous));
+  ASSERT_TRUE(map.find(wrapped));
+  EXPECT_EQ(255, *map.find(wrapped));
+}
+
+
+}
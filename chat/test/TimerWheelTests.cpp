@@ -0,0 +1,183 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "TimerWheel.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+
+using networking::TimerHandle;
+using networking::TimerWheel;
+
+
+namespace {
+
+
+using std::chrono::milliseconds;
+
+
+constexpr TimerWheel::Clock::time_point START{};
+
+
+TimerWheel::Clock::time_point
+at(uint64_t ms) {
+  return START + milliseconds{ms};
+}
+
+
+// Checks that a single timer fires at its deadline and not a tick earlier.
+void
+expectFiresAt(uint64_t deadline) {
+  TimerWheel wheel{START};
+  int fired = 0;
+  wheel.schedule(at(deadline), [&fired] { ++fired; });
+
+  EXPECT_EQ(0u, wheel.advance(at(deadline - 1)));
+  EXPECT_EQ(0, fired);
+  EXPECT_EQ(1u, wheel.size());
+  EXPECT_EQ(1u, wheel.advance(at(deadline)));
+  EXPECT_EQ(1, fired);
+  EXPECT_EQ(0u, wheel.size());
+}
+
+
+TEST(TimerWheelTest, firesWithinTheFirstLevel) {
+  expectFiresAt(1);
+  expectFiresAt(5);
+  expectFiresAt(255);
+}
+
+
+TEST(TimerWheelTest, firesDeadlinesMoreThan256TicksAway) {
+  expectFiresAt(256);
+  expectFiresAt(257);
+  expectFiresAt(1000);
+}
+
+
+TEST(TimerWheelTest, cascadesThroughEveryLevel) {
+  // One deadline for each of the upper levels, and the boundaries between
+  // them.
+  expectFiresAt(300);
+  expectFiresAt((uint64_t{1} << 16) - 1);
+  expectFiresAt(uint64_t{1} << 16);
+  expectFiresAt(70'000);
+  expectFiresAt((uint64_t{1} << 24) + 3);
+  expectFiresAt(20'000'000);
+}
+
+
+TEST(TimerWheelTest, parksDeadlinesBeyondTheTopLevel) {
+  // The four levels span 2^32 ticks, so this deadline starts out parked at
+  // the far end of the top level and is re-linked when that slot cascades.
+  expectFiresAt((uint64_t{1} << 32) + 12'345);
+  expectFiresAt((uint64_t{1} << 33) + 7);
+}
+
+
+TEST(TimerWheelTest, firesTimersInDeadlineOrderAcrossLevels) {
+  TimerWheel wheel{START};
+  std::vector<uint64_t> order;
+  for (uint64_t deadline : {70'000u, 5u, 300u, 256u, 65'536u}) {
+    wheel.schedule(at(deadline), [&order, deadline] { order.push_back(deadline); });
+  }
+  EXPECT_EQ(5u, wheel.advance(at(100'000)));
+  EXPECT_EQ((std::vector<uint64_t>{5, 256, 300, 65'536, 70'000}), order);
+}
+
+
+TEST(TimerWheelTest, cancelsAfterACascade) {
+  TimerWheel wheel{START};
+  int fired = 0;
+  auto handle = wheel.schedule(at(300), [&fired] { ++fired; });
+
+  // At tick 256 the timer moves from the second level into the first.
+  EXPECT_EQ(0u, wheel.advance(at(256)));
+  EXPECT_TRUE(wheel.cancel(handle));
+  EXPECT_EQ(0u, wheel.size());
+  EXPECT_EQ(0u, wheel.advance(at(1000)));
+  EXPECT_EQ(0, fired);
+  EXPECT_FALSE(wheel.cancel(handle));
+}
+
+
+TEST(TimerWheelTest, cancelsFromACallbackDuringACascade) {
+  TimerWheel wheel{START};
+  int fired = 0;
+  TimerHandle first;
+  TimerHandle second;
+  // Both timers cascade into the first level at tick 512 and fire in the
+  // same step, so whichever fires first cancels the other.
+  first = wheel.schedule(at(512), [&] { ++fired; wheel.cancel(second); });
+  second = wheel.schedule(at(512), [&] { ++fired; wheel.cancel(first); });
+  // This one has only just cascaded into the first level when it is
+  // cancelled.
+  TimerHandle later;
+  later = wheel.schedule(at(600), [&fired] { ++fired; });
+  wheel.schedule(at(512), [&] { EXPECT_TRUE(wheel.cancel(later)); });
+
+  EXPECT_EQ(2u, wheel.advance(at(512)));
+  EXPECT_EQ(1, fired);
+  EXPECT_EQ(0u, wheel.size());
+  EXPECT_EQ(0u, wheel.advance(at(1000)));
+  EXPECT_EQ(1, fired);
+}
+
+
+TEST(TimerWheelTest, nextExpiryIsALowerBoundThatMakesProgress) {
+  for (uint64_t deadline : {3u, 300u, 70'000u, 20'000'000u}) {
+    TimerWheel wheel{START};
+    EXPECT_FALSE(wheel.getNextExpiry());
+    int fired = 0;
+    wheel.schedule(at(deadline), [&fired] { ++fired; });
+
+    // Each level can add at most one intermediate wake up.
+    int wakeUps = 0;
+    while (fired == 0 && wakeUps <= 4) {
+      auto next = wheel.getNextExpiry();
+      ASSERT_TRUE(next);
+      EXPECT_LE(*next, at(deadline));
+      wheel.advance(*next);
+      ++wakeUps;
+    }
+    EXPECT_EQ(1, fired) << "deadline " << deadline;
+    EXPECT_FALSE(wheel.getNextExpiry());
+  }
+}
+
+
+TEST(TimerWheelTest, staleHandlesDoNotCancelReusedTimers) {
+  TimerWheel wheel{START};
+  auto stale = wheel.schedule(at(10), [] {});
+  EXPECT_TRUE(wheel.cancel(stale));
+
+  int fired = 0;
+  auto reused = wheel.schedule(at(10), [&fired] { ++fired; });
+  EXPECT_EQ(stale.index, reused.index);
+  EXPECT_FALSE(wheel.cancel(stale));
+  EXPECT_FALSE(wheel.cancel(TimerHandle{}));
+  EXPECT_EQ(1u, wheel.advance(at(10)));
+  EXPECT_EQ(1, fired);
+}
+
+
+TEST(TimerWheelTest, pastDeadlinesFireOnTheNextAdvance) {
+  TimerWheel wheel{START};
+  wheel.advance(at(50));
+  int fired = 0;
+  wheel.schedule(at(10), [&fired] { ++fired; });
+  EXPECT_EQ(1u, wheel.advance(at(51)));
+  EXPECT_EQ(1, fired);
+}
+
+
+}
@@ -32,6 +32,7 @@ main(int argc, char* argv[]) {
   };
 
   ChatWindow chatWindow(onTextEntry);
+  std::vector<networking::ReceivedMessage> incoming;
 
   while (!done && !client.isDisconnected()) {
     try {
@@ -43,10 +44,11 @@ main(int argc, char* argv[]) {
       done = true;
     }
 
-    auto response = client.receive();
-    if (!response.empty()) {
-      
-      chatWindow.displayText(response);
+    client.receive(incoming);
+    for (auto& message : incoming) {
+      if (message.type == networking::MessageType::TEXT) {
+        chatWindow.displayText(message.text);
+      }
     }
     chatWindow.update();
   }
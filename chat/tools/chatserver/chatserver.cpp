@@ -6,70 +6,142 @@
 /////////////////////////////////////////////////////////////////////////////
 
 
+#include "GameScheduler.h"
+#include "RoomManager.h"
 #include "Server.h"
 
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <unistd.h>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 
 using networking::Server;
+using networking::ServerOptions;
 using networking::Connection;
 using networking::Message;
+using networking::MessageType;
+using networking::RoomId;
+using networking::RoomManager;
+using scheduling::GameScheduler;
+using scheduling::Outbox;
+
+
+/**
+ *  Each room is hosted as its own game. A tick relays the room's chat lines to
+ *  every member of the room as one shared broadcast.
+ */
+class ChatRoom final : public scheduling::Game {
+public:
+  explicit ChatRoom(RoomId id)
+    : id{id}
+      { }
+
+  void
+  tick(const std::vector<Message>& inbox, Outbox& outbox) override {
+    if (inbox.empty()) {
+      return;
+    }
+    std::ostringstream log;
+    for (auto& message : inbox) {
+      log << message.connection.id << "> " << message.text << "\n";
+    }
+    outbox.broadcasts.push_back({id, std::make_shared<const std::string>(log.str())});
+  }
+
+private:
+  RoomId id;
+};
+
+
+// Every client starts in the lobby and may move with `join <room>`.
+constexpr RoomId LOBBY = 0;
 
 
-std::vector<Connection> clients;
+void
+enterRoom(RoomManager& rooms, GameScheduler& scheduler, Connection c, RoomId room) {
+  rooms.join(c, room);
+  if (!scheduler.hasGame(room)) {
+    scheduler.addGame(room, std::make_unique<ChatRoom>(room));
+  }
+}
+
+
+void
+releaseRoom(RoomManager& rooms, GameScheduler& scheduler, RoomId room) {
+  if (room != LOBBY && rooms.getMemberCount(room) == 0) {
+    scheduler.removeGame(room);
+  }
+}
 
 
 void
-onConnect(Connection c) {
+onConnect(RoomManager& rooms, GameScheduler& scheduler, Connection c) {
   std::cout << "New connection found: " << c.id << "\n";
-  clients.push_back(c);
+  enterRoom(rooms, scheduler, c, LOBBY);
 }
 
 
 void
-onDisconnect(Connection c) {
+onDisconnect(RoomManager& rooms, GameScheduler& scheduler, Connection c) {
   std::cout << "Connection lost: " << c.id << "\n";
-  auto eraseBegin = std::remove(std::begin(clients), std::end(clients), c);
-  clients.erase(eraseBegin, std::end(clients));
+  auto room = rooms.getRoom(c);
+  rooms.leave(c);
+  if (room) {
+    releaseRoom(rooms, scheduler, *room);
+  }
 }
 
 
 struct MessageResult {
-  std::string result;
+  std::unordered_map<RoomId, std::ostringstream> announcements;
   bool shouldShutdown;
 };
 
 
+// Commands are handled here on the main thread and removed from `incoming`.
+// Everything else is chat that stays in `incoming` for the rooms to process
+// in parallel, so that its storage is recycled by the next Server::receive().
 MessageResult
-processMessages(Server& server, const std::deque<Message>& incoming) {
-  std::ostringstream result;
-  bool quit = false;
+processMessages(Server& server,
+                RoomManager& rooms,
+                GameScheduler& scheduler,
+                std::vector<Message>& incoming) {
+  MessageResult result{{}, false};
+  auto chatEnd = incoming.begin();
   for (auto& message : incoming) {
-    if (message.text == "quit") {
+    auto room = rooms.getRoom(message.connection);
+    if (message.type == MessageType::BINARY || !room) {
+      // The chat log is text, so binary payloads are not relayed.
+      continue;
+    } else if (message.text == "quit") {
       server.disconnect(message.connection);
     } else if (message.text == "shutdown") {
       std::cout << "Shutting down.\n";
-      quit = true;
+      result.shouldShutdown = true;
+    } else if (message.text.rfind("join ", 0) == 0) {
+      RoomId target = std::strtoull(message.text.c_str() + 5, nullptr, 10);
+      enterRoom(rooms, scheduler, message.connection, target);
+      releaseRoom(rooms, scheduler, *room);
+      result.announcements[*room] << message.connection.id
+                                  << " left for room " << target << "\n";
+      result.announcements[target] << message.connection.id
+                                   << " joined room " << target << "\n";
     } else {
-      result << message.connection.id << "> " << message.text << "\n";
+      // Swapping rather than moving keeps every text's storage in `incoming`.
+      std::swap(*chatEnd, message);
+      ++chatEnd;
     }
   }
-  return MessageResult{result.str(), quit};
-}
-
-
-std::deque<Message>
-buildOutgoing(const std::string& log) {
-  std::deque<Message> outgoing;
-  for (auto client : clients) {
-    outgoing.push_back({client, log});
-  }
-  return outgoing;
+  incoming.erase(chatEnd, incoming.end());
+  return result;
 }
 
 
@@ -91,36 +163,80 @@ getHTTPMessage(const char* htmlLocation) {
 int
 main(int argc, char* argv[]) {
   if (argc < 3) {
-    std::cerr << "Usage:\n  " << argv[0] << " <port> <html response>\n"
+    std::cerr << "Usage:\n  " << argv[0]
+              << " <port> <html response> [I/O threads] [asset directory]\n"
               << "  e.g. " << argv[0] << " 4002 ./webchat.html\n";
     return 1;
   }
 
   unsigned short port = std::stoi(argv[1]);
-  Server server{port, getHTTPMessage(argv[2]), onConnect, onDisconnect};
+  ServerOptions options;
+  options.serveMetrics = true;
+  // Evict clients that vanished without closing their connection.
+  options.idleTimeout = std::chrono::minutes{5};
+  // Keep a single flooding client from delaying chat for everyone else.
+  options.rateLimits.messagesPerSecond = 100;
+  options.floodPolicy = networking::FloodPolicy::THROTTLE;
+  options.maxMessageSize = 64 * 1024;
+  if (3 < argc) {
+    options.ioThreads = std::stoi(argv[3]);
+  }
+  if (4 < argc) {
+    options.assetDirectory = argv[4];
+  }
+
+  // Created here rather than at namespace scope because the scheduler starts
+  // its worker threads on construction. Both must outlive the Server, whose
+  // callbacks use them.
+  RoomManager rooms;
+  GameScheduler scheduler{rooms};
+  Server server{port, getHTTPMessage(argv[2]),
+                [&rooms, &scheduler] (Connection c) { onConnect(rooms, scheduler, c); },
+                [&rooms, &scheduler] (Connection c) { onDisconnect(rooms, scheduler, c); },
+                options};
+
+  // Bounds how long the loop may sleep while no messages are arriving.
+  constexpr auto idleTick = std::chrono::seconds{1};
+  std::vector<Message> incoming;
+  std::vector<Message> unrouted;
+  Outbox outgoing;
 
   while (true) {
     bool errorWhileUpdating = false;
     try {
-      server.update();
+      server.updateFor(idleTick);
     } catch (std::exception& e) {
       std::cerr << "Exception from Server update:\n"
                 << " " << e.what() << "\n\n";
       errorWhileUpdating = true;
     }
 
-    auto incoming = server.receive();
-    auto [log, shouldQuit] = processMessages(server, incoming);
-    auto outgoing = buildOutgoing(log);
-    server.send(outgoing);
+    server.receive(incoming);
+    auto [announcements, shouldQuit] =
+      processMessages(server, rooms, scheduler, incoming);
+    for (auto& [room, log] : announcements) {
+      rooms.broadcast(server, room, std::make_shared<const std::string>(log.str()));
+    }
+
+    scheduler.route(incoming, unrouted);
+    unrouted.clear();
+    scheduler.tick(outgoing);
+    server.send(outgoing.messages);
+    for (auto& [room, text, type] : outgoing.broadcasts) {
+      rooms.broadcast(server, room, std::move(text), type);
+    }
+    outgoing.clear();
 
     if (shouldQuit || errorWhileUpdating) {
       break;
     }
-
-    sleep(1);
   }
 
+  // Deliver the final chat lines and close every client before exiting.
+  auto [closedCleanly, forced] = server.drain(std::chrono::seconds{5});
+  std::cout << "Closed " << closedCleanly << " connections cleanly and "
+            << forced << " forcibly.\n";
+
   return 0;
 }
 
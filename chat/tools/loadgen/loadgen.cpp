@@ -0,0 +1,273 @@
+/////////////////////////////////////////////////////////////////////////////
+//                         Single Threaded Networking
+//
+// This file is distributed under the MIT License. See the LICENSE file
+// for details.
+/////////////////////////////////////////////////////////////////////////////
+
+
+#include "Client.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using networking::Client;
+using networking::ClientContext;
+using networking::ReceivedMessage;
+using Clock = std::chrono::steady_clock;
+
+
+// Every message carries a tag identifying the sending bot and when it was
+// sent, so that the bot can measure the round trip when the server relays
+// the message back to it. Any server that echoes or broadcasts the text it
+// receives, like chatserver, can be measured.
+constexpr std::string_view TAG = "loadgen ";
+
+
+struct Settings {
+  std::string host;
+  std::string port;
+  std::size_t clients = 100;
+  double messagesPerSecond = 1.0;
+  std::size_t messageBytes = 64;
+  double rampUpSeconds = 5.0;
+  double durationSeconds = 30.0;
+};
+
+
+struct Stats {
+  uint64_t sent = 0;
+  uint64_t received = 0;
+  uint64_t bytesReceived = 0;
+  std::vector<Clock::duration> roundTrips;
+};
+
+
+class Bot {
+public:
+  Bot(ClientContext& context, const Settings& settings, std::size_t index,
+      Clock::time_point firstSend)
+    : client{context, settings.host, settings.port},
+      index{index},
+      prefix{std::string{TAG} + std::to_string(index) + " "},
+      padding(settings.messageBytes, 'x'),
+      nextSend{firstSend}
+      { }
+
+  void sendDue(Clock::time_point now, Clock::duration interval, Stats& stats);
+  void receive(Stats& stats);
+
+  [[nodiscard]] bool isDisconnected() const { return client.isDisconnected(); }
+
+private:
+  void scan(std::string_view text, Clock::time_point now, Stats& stats) const;
+
+  Client client;
+  std::size_t index;
+  std::string prefix;
+  std::string padding;
+  Clock::time_point nextSend;
+  std::vector<ReceivedMessage> incoming;
+};
+
+
+void
+Bot::sendDue(Clock::time_point now, Clock::duration interval, Stats& stats) {
+  while (nextSend <= now) {
+    auto sentAt = Clock::now().time_since_epoch().count();
+    auto message = prefix + std::to_string(sentAt) + " ";
+    message.append(padding, 0, padding.size() - std::min(padding.size(), message.size()));
+    client.send(std::move(message));
+    ++stats.sent;
+    nextSend += interval;
+  }
+}
+
+
+void
+Bot::receive(Stats& stats) {
+  client.receive(incoming);
+  auto now = Clock::now();
+  for (auto& message : incoming) {
+    ++stats.received;
+    stats.bytesReceived += message.text.size();
+    scan(message.text, now, stats);
+  }
+}
+
+
+void
+Bot::scan(std::string_view text, Clock::time_point now, Stats& stats) const {
+  // A relayed message may be embedded in other text (e.g. prefixed with the
+  // sender's connection) and several may arrive batched together.
+  for (auto found = text.find(prefix); found != std::string_view::npos;
+       found = text.find(prefix, found + 1)) {
+    auto start = text.data() + found + prefix.size();
+    Clock::rep sentAt = 0;
+    auto [end, error] = std::from_chars(start, text.data() + text.size(), sentAt);
+    if (error == std::errc{} && end != start) {
+      stats.roundTrips.push_back(now - Clock::time_point{Clock::duration{sentAt}});
+    }
+  }
+}
+
+
+void
+accumulate(Stats& totals, Stats& interim) {
+  totals.sent += interim.sent;
+  totals.received += interim.received;
+  totals.bytesReceived += interim.bytesReceived;
+  totals.roundTrips.insert(totals.roundTrips.end(),
+                           interim.roundTrips.begin(),
+                           interim.roundTrips.end());
+  interim = Stats{};
+}
+
+
+double
+toMilliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+
+void
+printInterval(double seconds, std::size_t connected, const Stats& stats) {
+  std::cout << std::fixed << std::setprecision(1)
+            << "[" << std::setw(6) << seconds << "s] "
+            << "clients " << connected
+            << "  sent/s " << stats.sent
+            << "  received/s " << stats.received
+            << "  KiB/s in " << stats.bytesReceived / 1024
+            << "\n";
+}
+
+
+void
+printSummary(const Settings& settings, double seconds, Stats& totals) {
+  auto& samples = totals.roundTrips;
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&samples] (double fraction) {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    auto rank = static_cast<std::size_t>(fraction * (samples.size() - 1));
+    return toMilliseconds(samples[rank]);
+  };
+
+  std::cout << std::fixed << std::setprecision(3)
+            << "\nclients:            " << settings.clients
+            << "\nduration (s):       " << seconds
+            << "\nmessages sent:      " << totals.sent
+            << "  (" << totals.sent / seconds << "/s)"
+            << "\nmessages received:  " << totals.received
+            << "  (" << totals.received / seconds << "/s)"
+            << "\nbytes received:     " << totals.bytesReceived
+            << "  (" << totals.bytesReceived / seconds / 1024 << " KiB/s)"
+            << "\nround trips:        " << samples.size()
+            << "\nround trip p50 (ms):  " << percentile(0.50)
+            << "\nround trip p99 (ms):  " << percentile(0.99)
+            << "\nround trip p999 (ms): " << percentile(0.999)
+            << "\nround trip max (ms):  "
+            << (samples.empty() ? 0.0 : toMilliseconds(samples.back()))
+            << "\n";
+}
+
+
+int
+main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage:\n  " << argv[0] << " <host> <port> [clients]"
+              << " [messages/s per client] [message bytes]"
+              << " [ramp up seconds] [duration seconds]\n"
+              << "  e.g. " << argv[0] << " localhost 4002 1000 2 128 10 60\n";
+    return 1;
+  }
+
+  Settings settings;
+  settings.host = argv[1];
+  settings.port = argv[2];
+  if (3 < argc) { settings.clients = std::stoul(argv[3]); }
+  if (4 < argc) { settings.messagesPerSecond = std::stod(argv[4]); }
+  if (5 < argc) { settings.messageBytes = std::stoul(argv[5]); }
+  if (6 < argc) { settings.rampUpSeconds = std::stod(argv[6]); }
+  if (7 < argc) { settings.durationSeconds = std::stod(argv[7]); }
+
+  using Seconds = std::chrono::duration<double>;
+  auto interval = std::chrono::duration_cast<Clock::duration>(
+    Seconds{1.0 / std::max(settings.messagesPerSecond, 1e-6)});
+  auto rampUp = std::chrono::duration_cast<Clock::duration>(
+    Seconds{settings.rampUpSeconds});
+  auto duration = std::chrono::duration_cast<Clock::duration>(
+    Seconds{settings.durationSeconds});
+
+  ClientContext context;
+  std::vector<std::unique_ptr<Bot>> bots;
+  bots.reserve(settings.clients);
+
+  // Spread the first sends of the bots across one interval so that they do
+  // not all fire in lockstep.
+  std::mt19937 random{std::random_device{}()};
+  std::uniform_int_distribution<Clock::rep> phase{0, interval.count()};
+
+  Stats interim;
+  Stats totals;
+  auto start = Clock::now();
+  auto nextReport = start + std::chrono::seconds{1};
+
+  while (true) {
+    auto now = Clock::now();
+    if (start + duration <= now) {
+      break;
+    }
+
+    // Ramp up by connecting bots linearly over the ramp up period.
+    auto elapsed = now - start;
+    auto due = elapsed < rampUp
+      ? static_cast<std::size_t>(settings.clients * (Seconds{elapsed} / Seconds{rampUp}))
+      : settings.clients;
+    while (bots.size() < std::max<std::size_t>(due, 1)
+        && bots.size() < settings.clients) {
+      auto firstSend = now + Clock::duration{phase(random)};
+      bots.push_back(std::make_unique<Bot>(context, settings, bots.size(), firstSend));
+    }
+
+    try {
+      context.updateFor(std::chrono::milliseconds{1});
+    } catch (std::exception& e) {
+      std::cerr << "Exception from ClientContext update:\n"
+                << " " << e.what() << "\n\n";
+      return 1;
+    }
+
+    now = Clock::now();
+    std::size_t connected = 0;
+    for (auto& bot : bots) {
+      if (bot->isDisconnected()) {
+        continue;
+      }
+      ++connected;
+      bot->receive(interim);
+      bot->sendDue(now, interval, interim);
+    }
+
+    if (nextReport <= now) {
+      printInterval(Seconds{now - start}.count(), connected, interim);
+      accumulate(totals, interim);
+      nextReport += std::chrono::seconds{1};
+    }
+  }
+
+  accumulate(totals, interim);
+  printSummary(settings, Seconds{Clock::now() - start}.count(), totals);
+  return 0;
+}
+